@@ -6,17 +6,259 @@
 #define AC_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <new>
 #include <queue>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "parallel/parallel.h"
+
 namespace ac {
 
+// child tables
+// =============================================================================
+namespace internal {
+enum { SPARSE_CHILD_LIMIT = 16 };  // byte child tables turn dense beyond
+
+// child table over a byte alphabet
+// up to SPARSE_CHILD_LIMIT children sit in an unordered array whose keys are
+// packed into 64-bit words and matched a word at a time, beyond that a
+// 256-entry array is indexed by character directly.
+// remarks: iterators stay valid until their own child is erased, they
+//  visit children in order of unsigned character value.
+template <typename Character, typename Node>
+class ByteChildTable {
+ public:
+  typedef Character key_type;
+  typedef Node* mapped_type;
+  typedef std::pair<Character, Node*> value_type;
+  typedef std::size_t size_type;
+
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename ByteChildTable::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+   public:
+    const_iterator() = default;
+    const_iterator(const ByteChildTable* table, unsigned index, Node* child)
+        : table_(table),
+          index_(index),
+          value_(static_cast<Character>(index), child) {}
+
+    reference operator*() const { return value_; }
+    pointer operator->() const { return &value_; }
+    const_iterator& operator++() {
+      *this = table_->lower_bound(index_ + 1);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator iter(*this);
+      ++(*this);
+      return iter;
+    }
+    bool operator==(const const_iterator& other) const {
+      return table_ == other.table_ && index_ == other.index_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    const ByteChildTable* table_ = nullptr;
+    unsigned index_ = DENSE;
+    value_type value_ = value_type();
+  };
+  typedef const_iterator iterator;
+
+ public:
+  explicit ByteChildTable(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : resource_(resource) {}
+  ByteChildTable(const ByteChildTable&) = delete;
+  ByteChildTable& operator=(const ByteChildTable&) = delete;
+  ~ByteChildTable() { deallocate(slots_, capacity_); }
+
+  bool empty() const { return 0 == size_; }
+  size_type size() const { return size_; }
+
+  // child on /c/, nullptr if none
+  Node* child(const Character& c) const {
+    const unsigned k = static_cast<unsigned char>(c);
+    if (DENSE == capacity_) return slots_[k];
+    const std::uint64_t ones = ~std::uint64_t(0) / 255;
+    const std::uint64_t* words = keys();
+    for (unsigned i = 0; i < size_; i += 8) {
+      std::uint64_t x = words[i / 8] ^ (ones * k);
+      std::uint64_t zero = (x - ones) & ~x & (ones << 7);
+      if (zero != 0) {  // the lowest flagged byte is a true match
+        unsigned j = i + __builtin_ctzll(zero) / 8;
+        return j < size_ ? slots_[j] : nullptr;
+      }
+    }
+    return nullptr;
+  }
+
+  const_iterator find(const Character& c) const {
+    Node* p = child(c);
+    if (nullptr == p) return end();
+    return const_iterator(this, static_cast<unsigned char>(c), p);
+  }
+
+  // pre-condition: value.second != nullptr
+  std::pair<const_iterator, bool> insert(const value_type& value) {
+    const unsigned k = static_cast<unsigned char>(value.first);
+    Node* p = child(value.first);
+    if (p != nullptr) return std::make_pair(const_iterator(this, k, p), false);
+    if (DENSE != capacity_ && size_ == capacity_) grow();
+    if (DENSE == capacity_) {
+      slots_[k] = value.second;
+    } else {
+      set_key(size_, k);
+      slots_[size_] = value.second;
+    }
+    ++size_;
+    return std::make_pair(const_iterator(this, k, value.second), true);
+  }
+
+  size_type erase(const Character& c) {
+    const unsigned k = static_cast<unsigned char>(c);
+    if (DENSE == capacity_) {
+      if (nullptr == slots_[k]) return 0;
+      slots_[k] = nullptr;
+      --size_;
+      return 1;
+    }
+    for (unsigned i = 0; i < size_; ++i) {
+      if (key(i) == k) {  // move the last one in
+        --size_;
+        set_key(i, key(size_));
+        slots_[i] = slots_[size_];
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  const_iterator begin() const { return lower_bound(0); }
+  const_iterator end() const { return const_iterator(this, DENSE, nullptr); }
+
+ private:
+  enum : unsigned { DENSE = 256 };
+
+  // the first child on a character not less than /index/
+  const_iterator lower_bound(unsigned index) const {
+    if (DENSE == capacity_) {
+      for (; index < DENSE; ++index) {
+        if (slots_[index] != nullptr) {
+          return const_iterator(this, index, slots_[index]);
+        }
+      }
+      return end();
+    }
+    unsigned best = DENSE, at = 0;
+    for (unsigned i = 0; i < size_; ++i) {
+      unsigned k = key(i);
+      if (k >= index && k < best) {
+        best = k;
+        at = i;
+      }
+    }
+    return DENSE == best ? end() : const_iterator(this, best, slots_[at]);
+  }
+
+  std::uint64_t* keys() const {
+    return reinterpret_cast<std::uint64_t*>(slots_ + capacity_);
+  }
+  unsigned key(unsigned i) const {
+    return (keys()[i / 8] >> (i % 8 * 8)) & 0xff;
+  }
+  void set_key(unsigned i, unsigned k) {
+    std::uint64_t& word = keys()[i / 8];
+    word &= ~(std::uint64_t(0xff) << (i % 8 * 8));
+    word |= std::uint64_t(k) << (i % 8 * 8);
+  }
+
+  static size_type bytes(unsigned capacity) {
+    if (DENSE == capacity) return DENSE * sizeof(Node*);
+    return capacity * sizeof(Node*) + (capacity + 7) / 8 * 8;
+  }
+
+  void deallocate(Node** slots, unsigned capacity) {
+    if (slots != nullptr) {
+      resource_->deallocate(slots, bytes(capacity), alignof(Node*));
+    }
+  }
+
+  // double the sparse capacity, or turn dense past SPARSE_CHILD_LIMIT
+  void grow() {
+    unsigned capacity = 0 == capacity_ ? 2 : capacity_ * 2;
+    if (capacity > SPARSE_CHILD_LIMIT) capacity = DENSE;
+    Node** slots = static_cast<Node**>(
+        resource_->allocate(bytes(capacity), alignof(Node*)));
+    if (DENSE == capacity) {
+      std::fill(slots, slots + DENSE, static_cast<Node*>(nullptr));
+      for (unsigned i = 0; i < size_; ++i) slots[key(i)] = slots_[i];
+    } else {
+      std::copy(slots_, slots_ + size_, slots);
+      std::memset(slots + capacity, 0, (capacity + 7) / 8 * 8);
+      if (size_ > 0) std::memcpy(slots + capacity, keys(), (size_ + 7) / 8 * 8);
+    }
+    deallocate(slots_, capacity_);
+    slots_ = slots;
+    capacity_ = capacity;
+  }
+
+ private:
+  std::pmr::memory_resource* resource_;
+  Node** slots_ = nullptr;
+  std::uint16_t size_ = 0;
+  std::uint16_t capacity_ = 0;
+};
+
+// child tables by alphabet: byte ones for char and the like, hash tables
+// for wider characters
+template <typename Character, typename Node,
+          bool Byte = sizeof(Character) == 1 &&
+                      std::is_integral<Character>::value>
+struct child_table_traits {
+  typedef std::pmr::unordered_map<Character, Node*> type;
+};
+template <typename Character, typename Node>
+struct child_table_traits<Character, Node, true> {
+  typedef ByteChildTable<Character, Node> type;
+};
+
+// child on /c/ in /table/, nullptr if none
+template <typename Table, typename Character>
+typename Table::mapped_type child_of(const Table& table, const Character& c) {
+  typename Table::const_iterator iter = table.find(c);
+  return table.end() == iter ? nullptr : iter->second;
+}
+template <typename Character, typename Node>
+Node* child_of(const ByteChildTable<Character, Node>& table,
+               const Character& c) {
+  return table.child(c);
+}
+}  // namespace internal
+
 // node to form trie
+// remarks: nodes never own their children, an Automation allocates all its
+// nodes and child tables from one memory resource and releases them at once.
 // =============================================================================
 template <typename Character, typename T>
 struct TrieNode {
@@ -24,7 +266,8 @@ struct TrieNode {
   typedef Character character_type;
   typedef T value_type;
   typedef TrieNode self;
-  typedef std::unordered_map<character_type, self*> child_table;
+  typedef typename internal::child_table_traits<Character, self>::type
+      child_table;
 
  public:
   self* parent = nullptr;
@@ -32,57 +275,64 @@ struct TrieNode {
   character_type route = {};
   std::ptrdiff_t height = 0;
   self* fail_pointer = nullptr;
+  self* output_pointer = nullptr;  // nearest node with value on fail chain
+  // nodes whose fail pointer is this one, as a doubly linked list, which
+  // lets Automation repair fail pointers after insert and erase
+  self* fail_children = nullptr;
+  self* fail_prev = nullptr;
+  self* fail_next = nullptr;
 
  public:
-  TrieNode() = default;
-  ~TrieNode() {
-    erase_value();
-    clear_children();
-  }
+  explicit TrieNode(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : children(resource) {}
+  TrieNode(const TrieNode&) = delete;
+  TrieNode& operator=(const TrieNode&) = delete;
+  ~TrieNode() { erase_value(); }
 
   void set_value(const value_type& value) {
     if (has_value()) {
-      *pvalue_ = value;
+      *pvalue() = value;
     } else {
-      pvalue_ = new value_type(value);
+      new (value_) value_type(value);
+      has_value_ = true;
     }
   }
 
-  bool has_value() const { return pvalue_ != nullptr; }
+  bool has_value() const { return has_value_; }
   value_type& value() {
     if (!has_value()) {
       throw std::runtime_error("TrieNode::value(): no value error");
     }
-    return *pvalue_;
+    return *pvalue();
   }
 
   const value_type& value() const {
     if (!has_value()) {
       throw std::runtime_error("TrieNode::value() const: no value error");
     }
-    return *pvalue_;
+    return *pvalue();
   }
 
   void erase_value() {
     if (!has_value()) {
       return;
     }
-    delete pvalue_;
-    pvalue_ = nullptr;
+    pvalue()->~value_type();
+    has_value_ = false;
   }
 
   bool eos() const { return has_value(); }
 
-  void clear_children() {
-    for (typename child_table::iterator iter = children.begin();
-         iter != children.end(); ++iter) {
-      delete iter->second;
-    }
-    children.clear();
+ private:
+  value_type* pvalue() { return reinterpret_cast<value_type*>(value_); }
+  const value_type* pvalue() const {
+    return reinterpret_cast<const value_type*>(value_);
   }
 
  private:
-  value_type* pvalue_ = nullptr;
+  alignas(value_type) unsigned char value_[sizeof(value_type)];  // inline
+  bool has_value_ = false;
 };
 
 // node pointer traits
@@ -104,16 +354,13 @@ namespace internal {
 // return whether found or not. if found, /cursor/ denotes the position
 template <typename InputIterator, typename NodePointer>
 bool find(InputIterator first, InputIterator last, NodePointer& cursor) {
-  typedef
-      typename node_pointer_traits<NodePointer>::child_iterator child_iterator;
-
   // check whether route exists in trie tree
   for (InputIterator curr = first; curr != last; ++curr) {
-    child_iterator child = cursor->children.find(*curr);
-    if (cursor->children.end() == child) {  // not found, do nothing
+    NodePointer child = child_of(cursor->children, *curr);
+    if (nullptr == child) {  // not found, do nothing
       return false;
     }
-    cursor = child->second;
+    cursor = child;
   }
   return cursor->has_value();
 }
@@ -126,11 +373,10 @@ void match(InputIterator first, InputIterator last, NodePointer& cursor,
   mismatch = std::make_pair(first, first);
   mismatch_node = std::make_pair(cursor, cursor);
   for (InputIterator curr = first; curr != last;) {
-    typename node_pointer_traits<NodePointer>::child_iterator iter =
-        cursor->children.find(*curr);
-    if (cursor->children.end() == iter) break;  // no more match
+    NodePointer child = child_of(cursor->children, *curr);
+    if (nullptr == child) break;  // no more match
 
-    cursor = iter->second;  // cursor move to next value
+    cursor = child;  // cursor move to next value
     ++curr;                 // the off-by-one matter
 
     mismatch.first = curr;
@@ -144,6 +390,9 @@ void match(InputIterator first, InputIterator last, NodePointer& cursor,
 
 }  // namespace internal
 
+template <typename Character, typename T>
+class CompiledAutomation;
+
 // AC automation
 // =============================================================================
 template <typename Character, typename T>
@@ -154,29 +403,42 @@ class Automation {
   typedef T mapped_type;
   typedef node* node_pointer;
   typedef const node* const_node_pointer;
+  typedef const_node_pointer state_type;
   typedef std::size_t size_type;
 
  public:
-  Automation() = default;
+  Automation() : root_(create_node()) {}
+  Automation(const Automation&) = delete;
+  Automation& operator=(const Automation&) = delete;
+  ~Automation() { destroy_values(); }
 
   // insert a subsequence into automation
   // return whether operation taken place
+  // remarks: once fail pointers are built, they are repaired in place for
+  //  the new nodes and the nodes failing to them, instead of a full rebuild
+  //  on next match
   template <typename InputIterator>
   bool insert(InputIterator first, InputIterator last, const mapped_type& value,
               node_pointer& eos_node) {
-    eos_node = &root_;
+    node_pointer fresh = nullptr;  // first new node on the path
+    eos_node = root_;
     for (; first != last; ++first) {
-      node_pointer& s = eos_node->children[*first];
-      if (nullptr == s) s = new node();
-      s->parent = eos_node;
-      s->route = *first;
-      s->height = eos_node->height + 1;
+      node_pointer s = internal::child_of(eos_node->children, *first);
+      if (nullptr == s) {
+        s = create_node();
+        s->parent = eos_node;
+        s->route = *first;
+        s->height = eos_node->height + 1;
+        eos_node->children.insert(
+            typename node::child_table::value_type(*first, s));
+        if (nullptr == fresh) fresh = s;
+      }
       eos_node = s;
     }
     bool already_exist = eos_node->eos();
     if (!already_exist) {
       eos_node->set_value(value);
-      fail_pointers_updated_ = false;
+      if (fail_pointers_updated_) repair_inserted(fresh, eos_node);
       ++counter_;
     }
     return !already_exist;
@@ -186,27 +448,35 @@ class Automation {
   // return whether operation taken place
   template <typename InputIterator>
   bool erase(InputIterator first, InputIterator last) {
-    typedef typename node_pointer_traits<node_pointer>::child_iterator
-        child_iterator;
-
     // check whether route exists in trie tree
-    node_pointer p = &root_;
+    node_pointer p = root_;
     for (InputIterator curr = first; curr != last; ++curr) {
-      child_iterator child = p->children.find(*curr);
-      if (p->children.end() == child) return false;  // not found, do nothing
-      p = child->second;
+      p = internal::child_of(p->children, *curr);
+      if (nullptr == p) return false;  // not found, do nothing
     }
 
+    if (!p->has_value()) return false;  // a prefix only, do nothing
+
     // remove related nodes
     p->erase_value();  // clear node mapped value (eos flag)
-    while (p != &root_ && !p->eos() &&
+    if (fail_pointers_updated_ && p != root_) {
+      propagate_output(p, p->output_pointer);
+    }
+    while (p != root_ && !p->eos() &&
            p->children.empty()) {  // no further path, remove this path
       node_pointer s = p->parent;
       s->children.erase(p->route);
-      delete p;
+      if (fail_pointers_updated_) {  // hand fail children to own fail
+        while (p->fail_children != nullptr) {
+          node_pointer child = p->fail_children;
+          unlink_fail(child);
+          link_fail(child, p->fail_pointer);
+        }
+        unlink_fail(p);
+      }
+      destroy_node(p);
       p = s;
     }
-    fail_pointers_updated_ = false;
     --counter_;
     return true;
   }
@@ -219,14 +489,17 @@ class Automation {
   //     NodePointer& eos_node) const;
 
   // empty automation
+  // remarks: nodes are released in bulk, only values with non-trivial
+  // destructors cost a walk through the trie.
   void clear() {
-    root_.erase_value();
-    root_.clear_children();
+    destroy_values();
+    resource_.release();
+    root_ = create_node();
     fail_pointers_updated_ = false;
     counter_ = 0;
   }
 
-  bool empty() const { return root_.children.empty() && !root_.has_value(); }
+  bool empty() const { return root_->children.empty() && !root_->has_value(); }
 
   size_type size() const { return counter_; }
 
@@ -239,7 +512,7 @@ class Automation {
       ForwardIterator first, ForwardIterator last) const {
     std::pair<ForwardIterator, ForwardIterator> mismatch;
     std::pair<const_node_pointer, const_node_pointer> mismatch_node;
-    const_node_pointer cursor = &root_;
+    const_node_pointer cursor = root_;
     internal::match(first, last, cursor, mismatch, mismatch_node);
     return mismatch;
   }
@@ -258,11 +531,9 @@ class Automation {
                    NodePointer& cursor,
                    std::pair<ForwardIterator, ForwardIterator>& fail,
                    std::pair<NodePointer, NodePointer>& fail_node) {
-    if (!fail_pointers_updated_) {  // confirm fail pointers
-      update_fail_pointers();
-    }
+    prepare();
     for (ForwardIterator curr = first; curr != last;) {
-      bool search_from_root = (&root_ == cursor);
+      bool search_from_root = (root_ == cursor);
 
       // find the first mismatch
       internal::match(curr, last, cursor, fail, fail_node);
@@ -282,23 +553,67 @@ class Automation {
     return false;
   }
 
-  node_pointer root_pointer() { return &root_; }
-  const_node_pointer root_pointer() const { return &root_; }
+  node_pointer root_pointer() { return root_; }
+  const_node_pointer root_pointer() const { return root_; }
+
+  // freeze current subsequences into a full DFA, see CompiledAutomation
+  CompiledAutomation<Character, T> compile() const {
+    return CompiledAutomation<Character, T>(*this);
+  }
+
+  // state interface shared with CompiledAutomation, see Scanner
+  // remarks: states are nodes, any insert or erase invalidates them
+  // confirm fail and output pointers, implied by every matching function
+  // remarks: safe to call from several threads sharing a const automation,
+  //  the first caller builds fail pointers under a lock, the others wait
+  void prepare() const {
+    if (fail_pointers_updated_.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(prepare_mutex_);
+    if (!fail_pointers_updated_.load(std::memory_order_relaxed)) {
+      update_fail_pointers();
+    }
+  }
+  state_type root() const { return root_; }
+  // pre-condition: prepare() called after the last insert or erase
+  state_type next(state_type state, const character_type& c) const {
+    for (;;) {
+      state_type child = internal::child_of(state->children, c);
+      if (child != nullptr) return child;
+      if (root_ == state) return root_;
+      state = state->fail_pointer;
+    }
+  }
+  // call report(length, value) for every subsequence which is a suffix of
+  // input read to reach /state/, longest first
+  template <typename Function>
+  void for_each_match(state_type state, Function&& report) const {
+    if (root_ == state || !state->eos()) state = state->output_pointer;
+    for (; state != nullptr; state = state->output_pointer) {
+      report(state->height, state->value());
+    }
+  }
 
  private:
-  void update_fail_pointers() {
+  // pre-condition: prepare_mutex_ held, or no other thread uses *this
+  void update_fail_pointers() const {
     typedef typename node_pointer_traits<node_pointer>::child_iterator
         child_iterator;
 
-    // fail pointer of root_ is root_ itself (for unity)
-    root_.fail_pointer = &root_;
+    // fail pointer of root_ is root_ itself (for unity), but root_ is not
+    // listed as its own fail child
+    root_->fail_pointer = root_;
+    root_->fail_children = nullptr;
 
     // push children of root_ into queue
     std::queue<node_pointer> node_queue;
-    for (child_iterator iter = root_.children.begin();
-         iter != root_.children.end(); ++iter) {
+    for (child_iterator iter = root_->children.begin();
+         iter != root_->children.end(); ++iter) {
       node_pointer p = iter->second;
-      p->fail_pointer = &root_;  // fail pointer set to root_
+      p->fail_children = nullptr;
+      link_fail(p, root_);  // fail pointer set to root_
+      p->output_pointer = nullptr;
       node_queue.push(p);
     }
 
@@ -314,35 +629,383 @@ class Automation {
         node_queue.push(pchild);  // push the child into queue
 
         // look for the same key to fail pointer's children
-        pchild->fail_pointer = find_fail_pointer(p->fail_pointer, route);
+        node_pointer fail = find_fail_pointer(p->fail_pointer, route);
+        pchild->fail_children = nullptr;
+        link_fail(pchild, fail);
+        pchild->output_pointer = output_of(fail);
       }
     }
 
-    // set updated flag
-    fail_pointers_updated_ = true;
+    // set updated flag, publishing the pointers to prepare() callers
+    fail_pointers_updated_.store(true, std::memory_order_release);
   }
 
   node_pointer find_fail_pointer(node_pointer parent_fail_pointer,
-                                 const character_type& route) {
-    typedef typename node_pointer_traits<node_pointer>::child_iterator
-        child_iterator;
+                                 const character_type& route) const {
+    for (node_pointer p = parent_fail_pointer;; p = p->fail_pointer) {
+      node_pointer fail_child = internal::child_of(p->children, route);
+      if (fail_child != nullptr) {
+        return fail_child;
+      } else if (p == root_) {
+        return root_;
+      }
+    }
+  }
+
+  // output pointer of a node failing to /fail/
+  node_pointer output_of(node_pointer fail) const {
+    return (fail != root_ && fail->eos()) ? fail : fail->output_pointer;
+  }
 
-    child_iterator fail_child = parent_fail_pointer->children.find(route);
-    if (fail_child != parent_fail_pointer->children.end()) {
-      return fail_child->second;
-    } else if (parent_fail_pointer == &root_) {
-      return &root_;
+  // pre-condition: /p/ is not in any fail children list
+  static void link_fail(node_pointer p, node_pointer fail) {
+    p->fail_pointer = fail;
+    p->fail_prev = nullptr;
+    p->fail_next = fail->fail_children;
+    if (fail->fail_children != nullptr) fail->fail_children->fail_prev = p;
+    fail->fail_children = p;
+  }
+
+  static void unlink_fail(node_pointer p) {
+    if (p->fail_prev != nullptr) {
+      p->fail_prev->fail_next = p->fail_next;
     } else {
-      return find_fail_pointer(parent_fail_pointer->fail_pointer, route);
+      p->fail_pointer->fail_children = p->fail_next;
+    }
+    if (p->fail_next != nullptr) p->fail_next->fail_prev = p->fail_prev;
+    p->fail_prev = p->fail_next = nullptr;
+  }
+
+  // set fail pointers of the new path [fresh, eos_node] and re-point nodes
+  // whose longest proper suffix is now a new node, then output pointers
+  // of nodes failing to eos_node, which just got a value
+  void repair_inserted(node_pointer fresh, node_pointer eos_node) {
+    for (node_pointer v = fresh; v != nullptr;) {
+      node_pointer p = v->parent;
+      node_pointer fail =
+          (p == root_) ? root_ : find_fail_pointer(p->fail_pointer, v->route);
+      adopt_fail_children(p, v);
+      link_fail(v, fail);
+      v->output_pointer = output_of(fail);
+      v = (v == eos_node) ? nullptr : v->children.begin()->second;
+    }
+    if (eos_node != root_) propagate_output(eos_node, eos_node);
+  }
+
+  // nodes u = x.route(v) with /p/ on the fail chain of x now fail to the
+  // new node /v/, a search in the fail tree of /p/ stops at nodes x having
+  // such a child, whose fail pointer is already deeper than /v/
+  void adopt_fail_children(node_pointer p, node_pointer v) {
+    std::vector<node_pointer> stack;
+    for (node_pointer x = p->fail_children; x != nullptr; x = x->fail_next) {
+      stack.push_back(x);
+    }
+    while (!stack.empty()) {
+      node_pointer x = stack.back();
+      stack.pop_back();
+      node_pointer u = internal::child_of(x->children, v->route);
+      if (u != nullptr) {
+        if (u->fail_pointer->height < v->height) {
+          unlink_fail(u);
+          link_fail(u, v);
+        }
+        continue;
+      }
+      for (node_pointer y = x->fail_children; y != nullptr; y = y->fail_next) {
+        stack.push_back(y);
+      }
+    }
+  }
+
+  // set output pointer of nodes failing to /p/ with no value in between
+  // to /output/
+  void propagate_output(node_pointer p, node_pointer output) {
+    std::vector<node_pointer> stack(1, p);
+    while (!stack.empty()) {
+      node_pointer x = stack.back();
+      stack.pop_back();
+      for (node_pointer y = x->fail_children; y != nullptr; y = y->fail_next) {
+        y->output_pointer = output;
+        if (!y->eos()) stack.push_back(y);
+      }
+    }
+  }
+
+  node_pointer create_node() {
+    void* p = resource_.allocate(sizeof(node), alignof(node));
+    return new (p) node(&resource_);
+  }
+
+  void destroy_node(node_pointer p) {
+    p->~node();
+    resource_.deallocate(p, sizeof(node), alignof(node));
+  }
+
+  // destructors of nodes are skipped on bulk release, except for values
+  void destroy_values() {
+    if (std::is_trivially_destructible<mapped_type>::value) {
+      return;
+    }
+    std::vector<node_pointer> stack(1, root_);
+    while (!stack.empty()) {
+      node_pointer p = stack.back();
+      stack.pop_back();
+      p->erase_value();
+      for (const auto& child : p->children) stack.push_back(child.second);
     }
   }
 
  private:
-  node root_;
-  bool fail_pointers_updated_ = false;
+  std::pmr::unsynchronized_pool_resource resource_;
+  node_pointer root_;
+  mutable std::atomic<bool> fail_pointers_updated_{false};
+  mutable std::mutex prepare_mutex_;  // serializes lazy builds in prepare()
   size_type counter_ = 0;
 };
 
+// compiled automation
+// =============================================================================
+namespace internal {
+// map characters onto dense alphabet classes 1, 2, ...
+// class 0 stands for every character absent from the keys
+template <typename Character, bool Byte = sizeof(Character) == 1 &&
+                                          std::is_integral<Character>::value>
+class AlphabetMap {
+ public:
+  typedef std::uint32_t class_type;
+
+  AlphabetMap() { std::fill(classes_, classes_ + 256, class_type(0)); }
+
+  class_type insert(const Character& c) {
+    class_type& k = classes_[static_cast<unsigned char>(c)];
+    if (0 == k) k = ++count_;
+    return k;
+  }
+  class_type operator()(const Character& c) const {
+    return classes_[static_cast<unsigned char>(c)];
+  }
+  std::size_t size() const { return count_ + 1; }
+
+ private:
+  class_type classes_[256];
+  class_type count_ = 0;
+};
+
+template <typename Character>
+class AlphabetMap<Character, false> {
+ public:
+  typedef std::uint32_t class_type;
+
+  class_type insert(const Character& c) {
+    class_type& k = classes_[c];
+    if (0 == k) k = static_cast<class_type>(classes_.size());
+    return k;
+  }
+  class_type operator()(const Character& c) const {
+    typename std::unordered_map<Character, class_type>::const_iterator iter =
+        classes_.find(c);
+    return classes_.end() == iter ? 0 : iter->second;
+  }
+  std::size_t size() const { return classes_.size() + 1; }
+
+ private:
+  std::unordered_map<Character, class_type> classes_;
+};
+}  // namespace internal
+
+// read-only snapshot of an Automation, goto and fail functions are folded
+// into one dense transition table over the compressed alphabet, so that
+// matching takes one table lookup per character.
+// remarks: states are opaque row offsets into the table, accepting states
+// (those with some subsequence as suffix) are numbered last so that the
+// acceptance test is a single comparison.
+template <typename Character, typename T>
+class CompiledAutomation {
+ public:
+  typedef Character character_type;
+  typedef T mapped_type;
+  typedef std::size_t size_type;
+  typedef std::uint32_t state_type;
+  typedef Automation<Character, T> automation_type;
+
+ public:
+  // empty automation, matches nothing
+  CompiledAutomation() : transitions_(1, 0), width_(1), accept_(1) {}
+
+  // throws std::length_error if the table cannot be indexed by state_type
+  explicit CompiledAutomation(const automation_type& automation) {
+    build(automation);
+  }
+
+  bool empty() const { return values_.empty(); }
+  size_type size() const { return values_.size(); }
+  size_type state_count() const { return transitions_.size() / width_; }
+  // length of the longest subsequence
+  std::ptrdiff_t max_length() const { return max_length_; }
+
+  state_type root() const { return 0; }
+  state_type next(state_type state, const character_type& c) const {
+    return transitions_[state + alphabet_(c)];
+  }
+  bool accepting(state_type state) const { return state >= accept_; }
+
+  // the longest subsequence which is a suffix of input read to reach /state/
+  // pre-condition: accepting(state)
+  std::ptrdiff_t match_length(state_type state) const {
+    return keys_[outputs_[output_index(state)].key].length;
+  }
+  const mapped_type& match_value(state_type state) const {
+    return values_[outputs_[output_index(state)].key];
+  }
+  // how many subsequences are suffixes of input read to reach /state/
+  size_type match_count(state_type state) const {
+    return accepting(state) ? outputs_[output_index(state)].count : 0;
+  }
+
+  // find the match ending first in [first, last), the longest one if
+  // several end there
+  // return subsequence range in [first, last) if found, [last, last) otherwise
+  template <typename BidirectionalIterator>
+  std::pair<BidirectionalIterator, BidirectionalIterator> find_first_of(
+      BidirectionalIterator first, BidirectionalIterator last) const {
+    state_type state = root();
+    while (first != last) {
+      state = next(state, *first);
+      ++first;
+      if (accepting(state)) {
+        BidirectionalIterator start = first;
+        std::advance(start, -match_length(state));
+        return std::make_pair(start, first);
+      }
+    }
+    return std::make_pair(last, last);
+  }
+
+  // state interface shared with Automation, see Scanner
+  void prepare() const {}
+  template <typename Function>
+  void for_each_match(state_type state, Function&& report) const {
+    if (!accepting(state)) return;
+    for (size_type k = outputs_[output_index(state)].key; k != npos();
+         k = keys_[k].next) {
+      report(keys_[k].length, values_[k]);
+    }
+  }
+
+  // how many occurrences of subsequences in [first, last), overlapped ones
+  // included
+  template <typename InputIterator>
+  size_type count(InputIterator first, InputIterator last) const {
+    size_type amount = 0;
+    state_type state = root();
+    for (; first != last; ++first) {
+      state = next(state, *first);
+      if (accepting(state)) amount += outputs_[output_index(state)].count;
+    }
+    return amount;
+  }
+
+ private:
+  struct Output {
+    size_type key;    // the longest matched subsequence
+    size_type count;  // matched subsequences in total
+  };
+  struct Key {
+    std::ptrdiff_t length;
+    size_type next;  // next shorter subsequence as suffix, dictionary link
+  };
+
+  static size_type npos() { return static_cast<size_type>(-1); }
+
+  size_type output_index(state_type state) const {
+    return (state - accept_) / width_;
+  }
+
+  void build(const automation_type& automation) {
+    typedef typename automation_type::const_node_pointer const_node_pointer;
+    const size_type npos = this->npos();
+
+    // collect alphabet and BFS order of trie nodes
+    std::vector<const_node_pointer> order(1, automation.root_pointer());
+    for (size_type i = 0; i < order.size(); ++i) {
+      for (const auto& child : order[i]->children) {
+        alphabet_.insert(child.first);
+        order.push_back(child.second);
+      }
+    }
+    const size_type n = order.size();
+    width_ = alphabet_.size();
+    if (n > std::numeric_limits<state_type>::max() / width_) {
+      throw std::length_error("CompiledAutomation: too many states");
+    }
+
+    // goto and fail functions in BFS numbering, each row is filled after
+    // the row of its fail state, which is always shallower
+    std::vector<size_type> delta(n * width_, 0);
+    std::vector<size_type> fail(n, 0);
+    std::vector<size_type> out(n, npos);  // longest matched state
+    std::vector<size_type> amount(n, 0);
+    std::vector<size_type> value_of(n, npos);
+    for (size_type i = 0, j = 1; i < n; ++i) {
+      size_type* row = &delta[i * width_];
+      if (i != 0) {
+        std::copy(&delta[fail[i] * width_], &delta[fail[i] * width_] + width_,
+                  row);
+        if (order[i]->has_value()) {  // the root is never a match
+          value_of[i] = values_.size();
+          values_.push_back(order[i]->value());
+          Key key = {order[i]->height, npos};
+          if (npos != out[fail[i]]) key.next = value_of[out[fail[i]]];
+          keys_.push_back(key);
+          max_length_ = std::max(max_length_, key.length);
+          out[i] = i;
+          amount[i] = 1;
+        }
+        if (npos == out[i]) out[i] = out[fail[i]];
+        amount[i] += amount[fail[i]];
+      }
+      for (const auto& child : order[i]->children) {
+        size_type k = alphabet_(child.first);
+        fail[j] = (i == 0) ? 0 : delta[fail[i] * width_ + k];
+        row[k] = j++;
+      }
+    }
+
+    // renumber, accepting states last
+    std::vector<size_type> id(n);
+    size_type accept_id = 0;
+    for (size_type i = 0; i < n; ++i) {
+      if (npos == out[i]) id[i] = accept_id++;
+    }
+    outputs_.reserve(n - accept_id);
+    for (size_type i = 0, a = accept_id; i < n; ++i) {
+      if (npos != out[i]) {
+        id[i] = a++;
+        Output output = {value_of[out[i]], amount[i]};
+        outputs_.push_back(output);
+      }
+    }
+    accept_ = static_cast<state_type>(accept_id * width_);
+    transitions_.resize(n * width_);
+    for (size_type i = 0; i < n; ++i) {
+      for (size_type k = 0; k < width_; ++k) {
+        transitions_[id[i] * width_ + k] =
+            static_cast<state_type>(id[delta[i * width_ + k]] * width_);
+      }
+    }
+  }
+
+ private:
+  internal::AlphabetMap<Character> alphabet_;
+  std::vector<state_type> transitions_;
+  std::vector<Output> outputs_;
+  std::vector<Key> keys_;
+  std::vector<mapped_type> values_;
+  size_type width_ = 1;
+  state_type accept_ = 1;
+  std::ptrdiff_t max_length_ = 0;
+};
+
 // find first subsequence in /subset/ in [first, last)
 // return subsequence range in [first, last) if found, [last, last) otherwise
 template <typename BidirectionalIterator, typename Character, typename Mapped>
@@ -375,24 +1038,151 @@ bool search(BidirectionalIterator first, BidirectionalIterator last,
   return find_first_of(first, last, subset).first != last;
 }
 
-// how many subsequence in /subset/ can be found in [first, last)
-template <typename ForwardIterator, typename Character, typename Mapped>
-std::size_t count(ForwardIterator first, ForwardIterator last,
-                  Automation<Character, Mapped>& subset) {
-  typedef
-      typename Automation<Character, Mapped>::const_node_pointer node_pointer;
-  std::pair<ForwardIterator, ForwardIterator> fail;
-  std::pair<node_pointer, node_pointer> fail_node;
-  node_pointer cursor = subset.root_pointer();
-  ForwardIterator curr = first;
+// how many occurrences of subsequences in /subset/ can be found in
+// [first, last), overlapped and nested ones included
+template <typename InputIterator, typename Character, typename Mapped>
+std::size_t count(InputIterator first, InputIterator last,
+                  const Automation<Character, Mapped>& subset) {
+  typedef typename Automation<Character, Mapped>::state_type state_type;
+  subset.prepare();
   std::size_t amount = 0;
-  while (subset.match_first(curr, last, cursor, fail, fail_node)) {
-    ++amount;
-    curr = fail.first;
+  state_type state = subset.root();
+  for (; first != last; ++first) {
+    state = subset.next(state, *first);
+    subset.for_each_match(
+        state, [&amount](std::ptrdiff_t, const Mapped&) { ++amount; });
   }
   return amount;
 }
 
+// find the first match ending in [first, last) with a compiled automation
+template <typename BidirectionalIterator, typename Character, typename Mapped>
+std::pair<BidirectionalIterator, BidirectionalIterator> find_first_of(
+    BidirectionalIterator first, BidirectionalIterator last,
+    const CompiledAutomation<Character, Mapped>& subset) {
+  return subset.find_first_of(first, last);
+}
+
+template <typename BidirectionalIterator, typename Character, typename Mapped>
+bool search(BidirectionalIterator first, BidirectionalIterator last,
+            const CompiledAutomation<Character, Mapped>& subset) {
+  return subset.find_first_of(first, last).first != last;
+}
+
+// every occurrence counts, overlapped ones included
+template <typename InputIterator, typename Character, typename Mapped>
+std::size_t count(InputIterator first, InputIterator last,
+                  const CompiledAutomation<Character, Mapped>& subset) {
+  return subset.count(first, last);
+}
+
+// streaming scanner
+// reports every occurrence of subsequences, overlapped and nested ones
+// included. input may be fed in consecutive chunks, as from a socket or a
+// huge file, positions count from the start of the stream.
+// =============================================================================
+template <typename Mapped>
+struct Match {
+  std::size_t end;     // occurrence is [end - length, end) of the stream
+  std::size_t length;
+  const Mapped* value;
+};
+
+template <typename AutomationT>
+class Scanner {
+ public:
+  typedef AutomationT automation_type;
+  typedef typename automation_type::state_type state_type;
+  typedef typename automation_type::mapped_type mapped_type;
+  typedef Match<mapped_type> match_type;
+  typedef std::size_t size_type;
+
+ public:
+  // pre-condition: /automation/ outlives the scanner and is not modified
+  // while scanning. scanners in several threads may share one automation
+  explicit Scanner(const automation_type& automation)
+      : automation_(&automation), state_(automation.root()) {}
+
+  // feed the next chunk [first, last), call report(const match_type&) for
+  // every occurrence ending in it, in order of end position
+  template <typename InputIterator, typename Function>
+  Function scan(InputIterator first, InputIterator last, Function report) {
+    automation_->prepare();
+    for (; first != last; ++first) {
+      state_ = automation_->next(state_, *first);
+      ++position_;
+      automation_->for_each_match(
+          state_, [this, &report](std::ptrdiff_t length,
+                                  const mapped_type& value) {
+            match_type match = {position_, static_cast<size_type>(length),
+                                &value};
+            report(match);
+          });
+    }
+    return report;
+  }
+
+  // restart as at the beginning of a stream
+  void reset() {
+    state_ = automation_->root();
+    position_ = 0;
+  }
+
+  size_type position() const { return position_; }
+  state_type state() const { return state_; }
+
+ private:
+  const automation_type* automation_;
+  state_type state_;
+  size_type position_ = 0;
+};
+
+namespace internal {
+enum { MIN_SCAN_CHUNK = 1 << 16 };  // characters per thread at least
+}  // namespace internal
+
+// scan [first, last) in chunks on /thread_count/ threads, 0 means hardware
+// concurrency, and return every occurrence in order of end position, with
+// positions counted from /first/. memory-mapped files can be scanned through
+// a pair of character pointers.
+// remarks: each chunk rescans max_length() - 1 characters before its start
+//  to recover the automaton state and reports only occurrences ending
+//  inside itself, so the overlap yields no duplicates.
+template <typename RandomAccessIterator, typename Character, typename Mapped>
+std::vector<Match<Mapped> > parallel_scan(
+    RandomAccessIterator first, RandomAccessIterator last,
+    const CompiledAutomation<Character, Mapped>& subset,
+    std::size_t thread_count = 0) {
+  typedef Match<Mapped> match_type;
+  const std::size_t n = last - first;
+  const std::size_t overlap =
+      subset.max_length() > 0 ? subset.max_length() - 1 : 0;
+  thread_count = parallel::thread_count(
+      thread_count, std::max<std::size_t>(n / internal::MIN_SCAN_CHUNK, 1));
+
+  std::vector<std::vector<match_type> > chunks(thread_count);
+  parallel::for_each_range(
+      n, thread_count, [&](std::size_t begin, std::size_t end, std::size_t i) {
+        std::size_t start = begin > overlap ? begin - overlap : 0;
+        Scanner<CompiledAutomation<Character, Mapped> > scanner(subset);
+        scanner.scan(first + start, first + begin, [](const match_type&) {});
+        scanner.scan(first + begin, first + end,
+                     [&chunks, i, start](match_type match) {
+                       match.end += start;
+                       chunks[i].push_back(match);
+                     });
+      });
+
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < chunks.size(); ++i) total += chunks[i].size();
+  std::vector<match_type> matches;
+  matches.reserve(total);
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    matches.insert(matches.end(), chunks[i].begin(), chunks[i].end());
+  }
+  return matches;
+}
+
 // trie map
 // perform std::map interface or like
 // =============================================================================
@@ -412,7 +1202,7 @@ class TrieMap : public Automation<Character, T> {
   typedef basic_iterator<node_pointer> iterator;
   typedef basic_iterator<const_node_pointer> const_iterator;
 
-  // TBD: to be implemented.
+  // iterates over subsequences in pre-order of the trie
   template <typename NodePointer>
   class basic_iterator {
    public:
@@ -425,6 +1215,7 @@ class TrieMap : public Automation<Character, T> {
     // // compile error in vs2005
     friend class basic_iterator<typename TrieMap::node_pointer>;
     friend class basic_iterator<typename TrieMap::const_node_pointer>;
+    friend class TrieMap;
 
    public:
     basic_iterator(node_pointer p, child_iterator pos)
@@ -459,10 +1250,46 @@ class TrieMap : public Automation<Character, T> {
     bool operator!=(const basic_iterator<NodePointer2>& other) const {
       return !(*this == other);
     }
+    basic_iterator& operator++() {
+      next_eos();
+      return *this;
+    }
+    basic_iterator operator++(int) {
+      basic_iterator iter(*this);
+      next_eos();
+      return iter;
+    }
 
    private:
-    bool next();      // move to next node  // TBD.
-    bool next_eos();  // move to next eos node  // TBD.
+    // move to next node, return false at end
+    bool next() {
+      node_pointer node = position_->second;
+      if (!node->children.empty()) {  // down to the first child
+        path_.clear();
+        parent_ = node;
+        position_ = parent_->children.begin();
+        return true;
+      }
+      return skip();
+    }
+    // move to next eos node, return false at end
+    bool next_eos() {
+      while (next()) {
+        if (position_->second->eos()) return true;
+      }
+      return false;
+    }
+    // move to next node out of the current subtree, return false at end
+    bool skip() {
+      path_.clear();
+      for (;;) {
+        if (++position_ != parent_->children.end()) return true;
+        if (nullptr == parent_->parent) return false;  // end of root
+        position_ = parent_->parent->children.find(parent_->route);
+        parent_ = parent_->parent;
+      }
+    }
+
    private:
     node_pointer parent_ = nullptr;
     child_iterator position_ = {};
@@ -472,15 +1299,15 @@ class TrieMap : public Automation<Character, T> {
 
  public:  // iterator observers
   iterator begin() {
-    return iterator(base::root_pointer(),
-                    base::root_pointer()->children.begin());
+    return first_eos(iterator(base::root_pointer(),
+                              base::root_pointer()->children.begin()));
   }
   iterator end() {
     return iterator(base::root_pointer(), base::root_pointer()->children.end());
   }
   const_iterator begin() const {
-    return const_iterator(base::root_pointer(),
-                          base::root_pointer()->children.begin());
+    return first_eos(const_iterator(base::root_pointer(),
+                                    base::root_pointer()->children.begin()));
   }
   const_iterator end() const {
     return const_iterator(base::root_pointer(),
@@ -588,6 +1415,93 @@ class TrieMap : public Automation<Character, T> {
     return count(sequence.begin(), sequence.end());
   }
 
+  // subsequences beginning with [first, last), for autocompletion
+  template <typename InputIterator>
+  std::pair<iterator, iterator> prefix_range(InputIterator first,
+                                             InputIterator last) {
+    return make_prefix_range<iterator>(base::root_pointer(), first, last);
+  }
+  template <typename InputIterator>
+  std::pair<const_iterator, const_iterator> prefix_range(
+      InputIterator first, InputIterator last) const {
+    return make_prefix_range<const_iterator>(base::root_pointer(), first,
+                                             last);
+  }
+  template <typename Container>
+  std::pair<iterator, iterator> prefix_range(const Container& prefix) {
+    return prefix_range(prefix.begin(), prefix.end());
+  }
+  template <typename Container>
+  std::pair<const_iterator, const_iterator> prefix_range(
+      const Container& prefix) const {
+    return prefix_range(prefix.begin(), prefix.end());
+  }
+
+  // subsequences being prefixes of [first, last), call report(length, value)
+  // for each, shortest first
+  template <typename InputIterator, typename Function>
+  Function common_prefix_search(InputIterator first, InputIterator last,
+                                Function report) const {
+    const_node_pointer p = base::root_pointer();
+    for (; first != last; ++first) {
+      p = internal::child_of(p->children, *first);
+      if (nullptr == p) break;
+      if (p->eos()) report(static_cast<size_type>(p->height), p->value());
+    }
+    return report;
+  }
+
+  // greedy longest-match segmentation of [first, last): from each position
+  // take the longest subsequence and call report(token_first, token_last,
+  // value), a character starting none is skipped
+  template <typename ForwardIterator, typename Function>
+  Function longest_match(ForwardIterator first, ForwardIterator last,
+                         Function report) const {
+    std::pair<ForwardIterator, ForwardIterator> mismatch;
+    std::pair<const_node_pointer, const_node_pointer> mismatch_node;
+    while (first != last) {
+      const_node_pointer cursor = base::root_pointer();
+      internal::match(first, last, cursor, mismatch, mismatch_node);
+      if (mismatch.second == first) {  // no subsequence starts here
+        ++first;
+      } else {
+        report(first, mismatch.second, mismatch_node.second->value());
+        first = mismatch.second;
+      }
+    }
+    return report;
+  }
+
+ private:
+  template <typename Iterator>
+  static Iterator first_eos(Iterator iter) {
+    if (iter.position_ != iter.parent_->children.end() &&
+        !iter.position_->second->eos()) {
+      iter.next_eos();
+    }
+    return iter;
+  }
+
+  template <typename Iterator, typename NodePointer, typename InputIterator>
+  static std::pair<Iterator, Iterator> make_prefix_range(NodePointer root,
+                                                         InputIterator first,
+                                                         InputIterator last) {
+    Iterator end(root, root->children.end());
+    NodePointer p = root;
+    for (; first != last; ++first) {
+      p = internal::child_of(p->children, *first);
+      if (nullptr == p) return std::make_pair(end, end);
+    }
+    if (p == root) {
+      return std::make_pair(first_eos(Iterator(root, root->children.begin())),
+                            end);
+    }
+    Iterator lower(p->parent, p->parent->children.find(p->route));
+    Iterator upper(lower);
+    upper.skip();  // stays at end if no more subtree follows
+    return std::make_pair(first_eos(lower), first_eos(upper));
+  }
+
  public:
   using base::erase;
   using base::insert;
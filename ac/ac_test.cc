@@ -1,10 +1,12 @@
 #include "ac.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -41,6 +43,62 @@ TEST(AutomationTest, ItWorks) {
   EXPECT_EQ(automation.size(), 0);
 }
 
+TEST(AutomationTest, ClearAndReuse) {
+  ac::TrieMap<char, std::string> mp;
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 100; ++i) {
+      mp[std::to_string(i * 37)] = std::string(40, 'a' + i % 26);
+    }
+    EXPECT_EQ(mp.size(), 100);
+    for (int i = 0; i < 100; i += 2) mp.erase(std::to_string(i * 37));
+    EXPECT_EQ(mp.size(), 50);
+    EXPECT_EQ(mp.find(std::string("0")), mp.end());
+    EXPECT_EQ(mp[std::string("37")], std::string(40, 'b'));
+    mp.clear();
+    EXPECT_TRUE(mp.empty());
+  }
+  mp[std::string("x")] = "y";
+  EXPECT_EQ(mp.size(), 1);
+}
+
+TEST(ByteChildTableTest, SparseAndDense) {
+  struct Node {};
+  std::vector<Node> nodes(256);
+  ac::internal::ByteChildTable<char, Node> table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(table.begin(), table.end());
+
+  auto first = table.insert({'\xff', &nodes[255]}).first;
+  for (int round = 0; round < 2; ++round) {  // sparse, then dense
+    for (int c = 0; c < 255; c += 3) {
+      EXPECT_EQ(table.insert({char(c), &nodes[c]}).second, round == 0);
+    }
+    EXPECT_EQ(table.size(), 86);
+    EXPECT_EQ(first->second, &nodes[255]);  // survives growth
+    for (int c = 0; c < 256; ++c) {
+      Node* expected = (c % 3 == 0) ? &nodes[c] : nullptr;
+      EXPECT_EQ(ac::internal::child_of(table, char(c)), expected);
+    }
+  }
+  std::vector<int> keys;
+  for (const auto& child : table) {
+    keys.push_back(static_cast<unsigned char>(child.first));
+  }
+  EXPECT_EQ(keys.size(), 86);
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+  EXPECT_EQ(table.erase('\x03'), 1);
+  EXPECT_EQ(table.erase('\x03'), 0);
+  EXPECT_EQ(table.find('\x03'), table.end());
+  EXPECT_EQ(table.size(), 85);
+
+  ac::internal::ByteChildTable<char, Node> sparse;
+  for (int c = 'a'; c < 'a' + 10; ++c) sparse.insert({char(c), &nodes[c]});
+  EXPECT_EQ(sparse.erase('a'), 1);  // the last one moves in
+  EXPECT_EQ(sparse.find('a'), sparse.end());
+  EXPECT_EQ(sparse.find('j')->second, &nodes['j']);
+  EXPECT_EQ(sparse.begin()->first, 'b');
+}
+
 TEST(TrieMapTest, ItWorks) {
   std::string str("abcdefghijklmnopqrstuvwxyz");
   std::string s1("abc"), s2("abcdf"), s3("mnopq"), s4("ghi"), s5("xyz"),
@@ -90,6 +148,64 @@ TEST(TrieMapTest, ItWorks) {
   EXPECT_EQ(ac::count(str.begin(), str.end(), mp), 3);
 }
 
+TEST(TrieMapTest, Iterate) {
+  std::vector<std::string> words = {"a", "ab", "abc", "abd", "b", "bcd", "c"};
+  ac::TrieMap<char, int> mp;
+  for (std::size_t i = 0; i < words.size(); ++i) mp.insert(words[i], i);
+  mp.erase(std::string("c"));
+
+  std::vector<std::string> actual;
+  for (auto iter = mp.begin(); iter != mp.end(); ++iter) {
+    actual.push_back(std::string(iter.key().begin(), iter.key().end()));
+    EXPECT_EQ(words[iter.value()], actual.back());
+  }
+  EXPECT_THAT(actual, ElementsAreArray({"a", "ab", "abc", "abd", "b", "bcd"}));
+
+  auto range = mp.prefix_range(std::string("ab"));
+  actual.clear();
+  for (; range.first != range.second; range.first++) {
+    actual.push_back(words[range.first.value()]);
+  }
+  EXPECT_THAT(actual, ElementsAreArray({"ab", "abc", "abd"}));
+
+  const ac::TrieMap<char, int>& cmp(mp);
+  auto crange = cmp.prefix_range(std::string("bc"));
+  ASSERT_NE(crange.first, crange.second);
+  EXPECT_EQ(words[crange.first.value()], "bcd");
+  EXPECT_EQ(++crange.first, crange.second);
+  EXPECT_EQ(crange.second, cmp.end());
+  crange = cmp.prefix_range(std::string("abcd"));
+  EXPECT_EQ(crange.first, crange.second);
+  crange = cmp.prefix_range(std::string());
+  EXPECT_EQ(crange.first, cmp.begin());
+}
+
+TEST(TrieMapTest, PrefixSearch) {
+  ac::TrieMap<char, int> mp;
+  std::vector<std::string> words = {"new", "news", "newspaper", "york", "n"};
+  for (std::size_t i = 0; i < words.size(); ++i) mp.insert(words[i], i);
+
+  std::string query("newspapers");
+  std::vector<std::pair<std::size_t, int>> prefixes;
+  mp.common_prefix_search(query.begin(), query.end(),
+                          [&prefixes](std::size_t length, int value) {
+                            prefixes.push_back({length, value});
+                          });
+  EXPECT_THAT(prefixes, ElementsAreArray({Pair(1, 4), Pair(3, 0), Pair(4, 1),
+                                          Pair(9, 2)}));
+
+  std::string text("newsnewyork!nn");
+  std::vector<std::pair<std::string, int>> tokens;
+  mp.longest_match(text.begin(), text.end(),
+                   [&tokens](std::string::iterator first,
+                             std::string::iterator last, int value) {
+                     tokens.push_back({std::string(first, last), value});
+                   });
+  EXPECT_THAT(tokens, ElementsAreArray({Pair("news", 1), Pair("new", 0),
+                                        Pair("york", 3), Pair("n", 4),
+                                        Pair("n", 4)}));
+}
+
 TEST(IteratorTest, ItWorks) {
   std::string str("abcdefghijklmnopqrstuvwxyz");
   std::string s1("abc"), s2("abcdf"), s3("mnopq"), s4("ghi");
@@ -142,3 +258,237 @@ TEST(AcTest, Chinese) {
   EXPECT_THAT(actual, ElementsAreArray(
                           {"上班", "今天", "时间", "睡觉", "上班", "早就"}));
 }
+
+TEST(CompiledAutomationTest, ItWorks) {
+  std::string str("abcdefghijklmnopqrstuvwxyz");
+  std::vector<std::string> substrs = {"abc", "abcdf", "mnopq", "bac", "c"};
+
+  ac::Automation<char, int> automation;
+  ac::Automation<char, int>::node_pointer pnode;
+  for (std::size_t i = 0; i < substrs.size(); ++i) {
+    automation.insert(substrs[i].begin(), substrs[i].end(), i, pnode);
+  }
+  const ac::CompiledAutomation<char, int> dfa = automation.compile();
+  EXPECT_EQ(dfa.size(), 5);
+
+  auto match = ac::find_first_of(str.begin(), str.end(), dfa);
+  EXPECT_EQ(match.first - str.begin(), 0);
+  EXPECT_EQ(match.second - str.begin(), 3);
+  EXPECT_TRUE(ac::search(str.begin(), str.end(), dfa));
+  EXPECT_FALSE(ac::search(str.begin() + 3, str.end() - 15, dfa));
+  EXPECT_EQ(ac::count(str.begin(), str.end(), dfa), 3);
+
+  auto state = dfa.root();
+  for (char c : std::string("xbac")) state = dfa.next(state, c);
+  EXPECT_TRUE(dfa.accepting(state));
+  EXPECT_EQ(dfa.match_length(state), 3);
+  EXPECT_EQ(dfa.match_value(state), 3);
+  EXPECT_EQ(dfa.match_count(state), 2);
+
+  ac::CompiledAutomation<char, int> none;
+  EXPECT_TRUE(none.empty());
+  EXPECT_EQ(ac::count(str.begin(), str.end(), none), 0);
+}
+
+TEST(CompiledAutomationTest, MatchesNaiveSearch) {
+  std::srand(7);
+  for (int round = 0; round < 20; ++round) {
+    ac::Automation<wchar_t, int> automation;
+    ac::Automation<wchar_t, int>::node_pointer pnode;
+    std::vector<std::wstring> words;
+    for (int i = 0; i < 30; ++i) {
+      std::wstring word(1 + std::rand() % 5, L'a');
+      for (auto& c : word) c = L'a' + std::rand() % 4;
+      if (automation.insert(word.begin(), word.end(), i, pnode)) {
+        words.push_back(word);
+      }
+    }
+    std::wstring text(500, L'a');
+    for (auto& c : text) c = L'a' + std::rand() % 5;
+    const auto dfa = automation.compile();
+
+    std::size_t expected = 0, first_end = text.size(), longest = 0;
+    for (const auto& word : words) {
+      for (std::size_t pos = text.find(word); pos != std::wstring::npos;
+           pos = text.find(word, pos + 1)) {
+        ++expected;
+        std::size_t end = pos + word.size();
+        if (end < first_end || (end == first_end && word.size() > longest)) {
+          first_end = end;
+          longest = word.size();
+        }
+      }
+    }
+    EXPECT_EQ(ac::count(text.begin(), text.end(), dfa), expected);
+    auto match = ac::find_first_of(text.begin(), text.end(), dfa);
+    EXPECT_EQ(match.second - text.begin(), first_end);
+    EXPECT_EQ(match.second - match.first, longest);
+  }
+}
+
+TEST(ScannerTest, ReportsEveryMatch) {
+  std::vector<std::string> words = {"he", "she", "his", "hers", "e"};
+  ac::Automation<char, int> automation;
+  ac::Automation<char, int>::node_pointer pnode;
+  for (std::size_t i = 0; i < words.size(); ++i) {
+    automation.insert(words[i].begin(), words[i].end(), i, pnode);
+  }
+  const auto dfa = automation.compile();
+  std::string text("ushers");
+  EXPECT_EQ(ac::count(text.begin(), text.end(), automation), 4);
+
+  typedef ac::Match<int> match_type;
+  std::vector<std::pair<std::size_t, int>> actual;
+  auto collect = [&actual](const match_type& m) {
+    actual.push_back({m.end - m.length, *m.value});
+  };
+  ac::Scanner<ac::Automation<char, int>> scanner(automation);
+  scanner.scan(text.begin(), text.begin() + 3, collect);
+  scanner.scan(text.begin() + 3, text.end(), collect);
+  EXPECT_EQ(scanner.position(), text.size());
+  EXPECT_THAT(actual, ElementsAreArray({Pair(1, 1), Pair(2, 0), Pair(3, 4),
+                                        Pair(2, 3)}));
+  actual.clear();
+  ac::Scanner<ac::CompiledAutomation<char, int>> dfa_scanner(dfa);
+  for (char c : text) dfa_scanner.scan(&c, &c + 1, collect);
+  EXPECT_THAT(actual, ElementsAreArray({Pair(1, 1), Pair(2, 0), Pair(3, 4),
+                                        Pair(2, 3)}));
+}
+
+TEST(ScannerTest, MatchesNaiveSearch) {
+  std::srand(11);
+  for (int round = 0; round < 20; ++round) {
+    ac::TrieMap<char, int> mp;
+    for (int i = 0; i < 40; ++i) {
+      std::string word(1 + std::rand() % 6, 'a');
+      for (auto& c : word) c = 'a' + std::rand() % 3;
+      mp.insert(word, i);
+    }
+    std::string text(300, 'a');
+    for (auto& c : text) c = 'a' + std::rand() % 4;
+
+    std::vector<std::pair<std::size_t, std::size_t>> expected, actual;
+    for (std::size_t end = 1; end <= text.size(); ++end) {
+      for (std::size_t length = end; length > 0; --length) {
+        if (mp.count(text.substr(end - length, length)) > 0) {
+          expected.push_back({end, length});
+        }
+      }
+    }
+    ac::Scanner<ac::Automation<char, int>> scanner(mp);
+    for (std::size_t i = 0; i < text.size(); i += 7) {
+      scanner.scan(text.begin() + i,
+                   text.begin() + std::min(i + 7, text.size()),
+                   [&actual](const ac::Match<int>& m) {
+                     actual.push_back({m.end, m.length});
+                   });
+    }
+    EXPECT_EQ(actual, expected);
+    EXPECT_EQ(ac::count(text.begin(), text.end(), mp), expected.size());
+
+    actual.clear();
+    const auto dfa = mp.compile();
+    ac::Scanner<ac::CompiledAutomation<char, int>> dfa_scanner(dfa);
+    dfa_scanner.scan(text.begin(), text.end(),
+                     [&actual](const ac::Match<int>& m) {
+                       actual.push_back({m.end, m.length});
+                     });
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST(ScannerTest, SharedAcrossThreads) {
+  // the automation is unprepared, both scanners race to build fail pointers
+  ac::Automation<char, int> automation;
+  ac::Automation<char, int>::node_pointer pnode;
+  std::srand(23);
+  for (int i = 0; i < 500; ++i) {
+    std::string word(1 + std::rand() % 8, 'a');
+    for (auto& c : word) c = 'a' + std::rand() % 4;
+    automation.insert(word.begin(), word.end(), i, pnode);
+  }
+  std::string text(1 << 16, 'a');
+  for (auto& c : text) c = 'a' + std::rand() % 4;
+
+  const ac::Automation<char, int>& shared = automation;
+  std::size_t counts[2] = {0, 0};
+  std::vector<std::thread> threads;
+  for (std::size_t& count : counts) {
+    threads.push_back(std::thread([&shared, &text, &count]() {
+      ac::Scanner<ac::Automation<char, int>> scanner(shared);
+      scanner.scan(text.begin(), text.end(),
+                   [&count](const ac::Match<int>&) { ++count; });
+    }));
+  }
+  for (auto& thread : threads) thread.join();
+  std::size_t expected = ac::count(text.begin(), text.end(), shared);
+  EXPECT_GT(expected, 0);
+  EXPECT_EQ(counts[0], expected);
+  EXPECT_EQ(counts[1], expected);
+}
+
+TEST(ScannerTest, IncrementalUpdates) {
+  std::srand(17);
+  ac::TrieMap<char, int> mp;
+  std::vector<std::string> words;
+  std::string text(200, 'a');
+  for (auto& c : text) c = 'a' + std::rand() % 2;
+  for (int step = 0; step < 300; ++step) {
+    std::string word(1 + std::rand() % 5, 'a');
+    for (auto& c : word) c = 'a' + std::rand() % 2;
+    if (std::rand() % 3 == 0) {
+      bool exists = mp.count(word) > 0;
+      EXPECT_EQ(mp.erase(word), exists);
+    } else {
+      mp.insert(word, step);
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> expected, actual;
+    for (std::size_t end = 1; end <= text.size(); ++end) {
+      for (std::size_t length = std::min<std::size_t>(end, 5); length > 0;
+           --length) {
+        if (mp.count(text.substr(end - length, length)) > 0) {
+          expected.push_back({end, length});
+        }
+      }
+    }
+    ac::Scanner<ac::Automation<char, int>> scanner(mp);
+    scanner.scan(text.begin(), text.end(),
+                 [&actual](const ac::Match<int>& m) {
+                   actual.push_back({m.end, m.length});
+                 });
+    ASSERT_EQ(actual, expected);
+  }
+}
+
+TEST(ParallelScanTest, MatchesScanner) {
+  std::srand(13);
+  ac::Automation<char, int> automation;
+  ac::Automation<char, int>::node_pointer pnode;
+  for (int i = 0; i < 200; ++i) {
+    std::string word(1 + std::rand() % 12, 'a');
+    for (auto& c : word) c = 'a' + std::rand() % 3;
+    automation.insert(word.begin(), word.end(), i, pnode);
+  }
+  const auto dfa = automation.compile();
+  std::string text(300000, 'a');
+  for (auto& c : text) c = 'a' + std::rand() % 4;
+
+  typedef ac::Match<int> match_type;
+  std::vector<match_type> expected;
+  ac::Scanner<ac::CompiledAutomation<char, int>> scanner(dfa);
+  scanner.scan(text.begin(), text.end(), [&expected](const match_type& m) {
+    expected.push_back(m);
+  });
+  for (std::size_t threads : {1, 3, 4}) {
+    auto actual = ac::parallel_scan(text.data(), text.data() + text.size(),
+                                    dfa, threads);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < actual.size(); ++i) {
+      ASSERT_EQ(actual[i].end, expected[i].end);
+      ASSERT_EQ(actual[i].length, expected[i].length);
+      ASSERT_EQ(actual[i].value, expected[i].value);
+    }
+  }
+  EXPECT_TRUE(ac::parallel_scan(text.begin(), text.begin(), dfa).empty());
+}
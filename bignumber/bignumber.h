@@ -4,22 +4,37 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "fft/fft.h"
+
 namespace bignumber {
 
-// pre-condition: [low_beg1, high_end1) [low_beg2, high_end2) are
-//  big numbers with digits from low to high
-// pre-condition: result has enough space to contain the final result
-// remarks: calculate product of big numbers [low_beg1, high_end1) and
-//  [low_beg2, high_end2), add the product to big number result.
+namespace internal {
+
+// shorter operand length (in digits) where multiplies() switches from
+// schoolbook to karatsuba, and from karatsuba to number theoretic transform
+enum { KARATSUBA_CUTOFF = 32, NTT_CUTOFF = 1024 };
+
+// unnormalized product coefficients, wraps modulo 2^128 in intermediate steps
+typedef unsigned __int128 coefficient_type;
+
+// schoolbook multiplication with carry, see multiplies()
 template <typename ForwardIterator1, typename ForwardIterator2, typename DigitT,
           typename RandomAccessIterator>
-RandomAccessIterator multiplies(ForwardIterator1 low_beg1,
-                                ForwardIterator1 high_end1,
-                                ForwardIterator2 low_beg2,
-                                ForwardIterator2 high_end2, const DigitT& round,
-                                RandomAccessIterator result) {
+RandomAccessIterator schoolbook_multiplies(ForwardIterator1 low_beg1,
+                                           ForwardIterator1 high_end1,
+                                           ForwardIterator2 low_beg2,
+                                           ForwardIterator2 high_end2,
+                                           const DigitT& round,
+                                           RandomAccessIterator result) {
   typedef typename std::iterator_traits<RandomAccessIterator>::difference_type
       difference_type;
   typedef DigitT digit_type;
@@ -45,6 +60,1080 @@ RandomAccessIterator multiplies(ForwardIterator1 low_beg1,
   return result + pos_end;
 }
 
+// result[0, 2 * len - 1) = coefficients of seq1[0, len) * seq2[0, len)
+inline void karatsuba(const coefficient_type* seq1,
+                      const coefficient_type* seq2, std::size_t len,
+                      coefficient_type* result) {
+  std::fill(result, result + 2 * len - 1, coefficient_type(0));
+  if (len <= KARATSUBA_CUTOFF) {
+    for (std::size_t i = 0; i < len; ++i) {
+      for (std::size_t j = 0; j < len; ++j) result[i + j] += seq1[i] * seq2[j];
+    }
+    return;
+  }
+
+  // seq = low + high * x^low_len, high_len >= low_len
+  std::size_t low_len = len >> 1, high_len = len - low_len;
+  std::vector<coefficient_type> sum1(seq1 + low_len, seq1 + len);
+  std::vector<coefficient_type> sum2(seq2 + low_len, seq2 + len);
+  for (std::size_t i = 0; i < low_len; ++i) {
+    sum1[i] += seq1[i];
+    sum2[i] += seq2[i];
+  }
+  std::vector<coefficient_type> low(2 * high_len), high(2 * high_len),
+      middle(2 * high_len);
+  karatsuba(seq1, seq2, low_len, low.data());
+  karatsuba(seq1 + low_len, seq2 + low_len, high_len, high.data());
+  karatsuba(sum1.data(), sum2.data(), high_len, middle.data());
+
+  // middle = (low1 + high1) * (low2 + high2) - low - high
+  for (std::size_t i = 0; i + 1 < 2 * low_len; ++i) middle[i] -= low[i];
+  for (std::size_t i = 0; i + 1 < 2 * high_len; ++i) middle[i] -= high[i];
+  for (std::size_t i = 0; i + 1 < 2 * low_len; ++i) result[i] += low[i];
+  for (std::size_t i = 0; i + 1 < 2 * high_len; ++i) {
+    result[low_len + i] += middle[i];
+    result[2 * low_len + i] += high[i];
+  }
+}
+
+// coefficients of seq1 * seq2 by karatsuba, longer operand is cut into
+// pieces of the shorter operand's length
+inline void karatsuba(const std::vector<coefficient_type>& seq1,
+                      const std::vector<coefficient_type>& seq2,
+                      std::vector<coefficient_type>& result) {
+  const std::vector<coefficient_type>& longer =
+      seq1.size() >= seq2.size() ? seq1 : seq2;
+  const std::vector<coefficient_type>& shorter =
+      seq1.size() >= seq2.size() ? seq2 : seq1;
+  std::size_t len = shorter.size();
+  result.assign(longer.size() + len - 1, 0);
+  std::vector<coefficient_type> piece(len), product(2 * len - 1);
+  for (std::size_t pos = 0; pos < longer.size(); pos += len) {
+    std::size_t piece_len = std::min(len, longer.size() - pos);
+    std::copy(longer.begin() + pos, longer.begin() + pos + piece_len,
+              piece.begin());
+    std::fill(piece.begin() + piece_len, piece.end(), coefficient_type(0));
+    karatsuba(piece.data(), shorter.data(), len, product.data());
+    for (std::size_t i = 0; i < product.size() && pos + i < result.size();
+         ++i) {
+      result[pos + i] += product[i];
+    }
+  }
+}
+
+// coefficients of seq1 * seq2 by number theoretic transform, consecutive
+// digits are packed into base round^pack before transform.
+// return false if the product can not be computed exactly this way
+template <typename DigitT>
+bool ntt_multiplies(const std::vector<coefficient_type>& seq1,
+                    const std::vector<coefficient_type>& seq2,
+                    const DigitT& round,
+                    std::vector<coefficient_type>& result) {
+  // choose largest pack with base round^pack <= 2^32 whose convolution
+  // values stay below the exact limit of fft::ntt_convolve()
+  const coefficient_type limit = fft::ntt_convolve_limit();
+  const coefficient_type base_limit = coefficient_type(1) << 32;
+  std::size_t shorter = std::min(seq1.size(), seq2.size()), pack = 0;
+  coefficient_type base = 1;
+  for (coefficient_type next = round; next <= base_limit; next *= round) {
+    std::size_t count = (shorter + pack) / (pack + 1);
+    if ((next - 1) * (next - 1) > limit / count) break;
+    base = next;
+    ++pack;
+  }
+  if (0 == pack) {  // round too large for a single digit
+    coefficient_type max_digit = coefficient_type(round) - 1;
+    if (max_digit > (coefficient_type(1) << 64) - 1 ||
+        max_digit * max_digit > limit / shorter) {
+      return false;
+    }
+    base = round;
+    pack = 1;
+  }
+
+  std::vector<std::uint64_t> packed1((seq1.size() + pack - 1) / pack),
+      packed2((seq2.size() + pack - 1) / pack);
+  if (packed1.size() + packed2.size() - 1 > fft::ntt_convolve_max_length()) {
+    return false;
+  }
+  for (std::size_t i = seq1.size(); i-- > 0;) {
+    packed1[i / pack] = packed1[i / pack] * round + std::uint64_t(seq1[i]);
+  }
+  for (std::size_t i = seq2.size(); i-- > 0;) {
+    packed2[i / pack] = packed2[i / pack] * round + std::uint64_t(seq2[i]);
+  }
+  std::vector<coefficient_type> product(packed1.size() + packed2.size() - 1);
+  fft::ntt_convolve(packed1.begin(), packed1.end(), packed2.begin(),
+                    packed2.end(), product.begin());
+
+  // normalize to base round^pack, then unpack to base round digits
+  result.assign(product.size() * pack + pack, 0);
+  coefficient_type carry = 0;
+  std::size_t pos = 0;
+  for (std::size_t i = 0; i < product.size() || carry > 0; ++i) {
+    coefficient_type value = carry + (i < product.size() ? product[i] : 0);
+    carry = value / base;
+    std::uint64_t digits = std::uint64_t(value % base);
+    for (std::size_t j = 0; j < pack; ++j, ++pos) {
+      result[pos] = digits % round;
+      digits /= round;
+    }
+  }
+  // product has at most seq1.size() + seq2.size() digits
+  result.resize(seq1.size() + seq2.size());
+  if (0 == result.back()) result.pop_back();
+  return true;
+}
+
+// add coefficients to big number result with carry,
+// return end of the highest digit written
+template <typename DigitT, typename RandomAccessIterator>
+RandomAccessIterator add_coefficients(
+    const std::vector<coefficient_type>& coefficients, const DigitT& round,
+    RandomAccessIterator result) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  const coefficient_type wide_round = round;
+  const std::uint64_t narrow_round = std::uint64_t(round);
+  const coefficient_type narrow_limit = coefficient_type(1) << 63;
+  coefficient_type carry = 0;
+  std::size_t pos = 0;
+  for (; pos < coefficients.size() || carry > 0; ++pos) {
+    coefficient_type value = carry + coefficient_type(result[pos]);
+    if (pos < coefficients.size()) value += coefficients[pos];
+    if (value < narrow_limit && wide_round < narrow_limit) {
+      std::uint64_t narrow = std::uint64_t(value);  // cheap 64 bit division
+      carry = narrow / narrow_round;
+      result[pos] = value_type(narrow % narrow_round);
+    } else {
+      carry = value / wide_round;
+      result[pos] = value_type(value % wide_round);
+    }
+  }
+  return result + pos;
+}
+
+// integer types BigInt converts from implicitly. bool and character types
+// are left out, true or 'a' is hardly meant as a number
+template <typename T>
+struct is_integer
+    : std::integral_constant<bool, std::is_integral<T>::value &&
+                                       !std::is_same<T, bool>::value &&
+                                       !std::is_same<T, char>::value &&
+                                       !std::is_same<T, wchar_t>::value &&
+                                       !std::is_same<T, char16_t>::value &&
+                                       !std::is_same<T, char32_t>::value> {};
+
+}  // namespace internal
+
+// pre-condition: [low_beg1, high_end1) [low_beg2, high_end2) are
+//  big numbers with digits from low to high
+// pre-condition: result has enough space to contain the final result
+// remarks: calculate product of big numbers [low_beg1, high_end1) and
+//  [low_beg2, high_end2), add the product to big number result.
+// remarks: schoolbook multiplication is used for short operands, karatsuba
+//  and number theoretic transform (exact) for longer ones, chosen by the
+//  length of the shorter operand. digits and round must be non-negative, and
+//  sums of digit products must fit in 128 bits.
+template <typename ForwardIterator1, typename ForwardIterator2, typename DigitT,
+          typename RandomAccessIterator>
+RandomAccessIterator multiplies(ForwardIterator1 low_beg1,
+                                ForwardIterator1 high_end1,
+                                ForwardIterator2 low_beg2,
+                                ForwardIterator2 high_end2, const DigitT& round,
+                                RandomAccessIterator result) {
+  using internal::coefficient_type;
+  std::size_t len1 = std::distance(low_beg1, high_end1);
+  std::size_t len2 = std::distance(low_beg2, high_end2);
+  if (std::min(len1, len2) < internal::KARATSUBA_CUTOFF) {
+    return internal::schoolbook_multiplies(low_beg1, high_end1, low_beg2,
+                                           high_end2, round, result);
+  }
+
+  std::vector<coefficient_type> seq1, seq2, product;
+  seq1.reserve(len1);
+  seq2.reserve(len2);
+  for (; low_beg1 != high_end1; ++low_beg1) seq1.push_back(*low_beg1);
+  for (; low_beg2 != high_end2; ++low_beg2) seq2.push_back(*low_beg2);
+  if (std::min(len1, len2) < internal::NTT_CUTOFF ||
+      !internal::ntt_multiplies(seq1, seq2, round, product)) {
+    internal::karatsuba(seq1, seq2, product);
+  }
+  return internal::add_coefficients(product, round, result);
+}
+
+// class BigInt: arbitrary precision signed integer
+// =============================================================================
+// remarks: magnitude is stored as little endian 64 bit limbs without leading
+//  zero limbs (zero has no limbs and is never negative), carries go through
+//  unsigned __int128. multiplication picks schoolbook, karatsuba or number
+//  theoretic transform by operand size; decimal conversion splits the number
+//  by powers of 10^19 (divide and conquer).
+class BigInt {
+ public:
+  typedef std::uint64_t limb_type;
+  typedef unsigned __int128 double_limb_type;
+  typedef std::vector<limb_type> limb_vector;
+  typedef std::size_t size_type;
+
+  // shorter operand length (in limbs) where multiplication switches from
+  // schoolbook to karatsuba, and from karatsuba to number theoretic transform
+  enum { KARATSUBA_CUTOFF = 40, NTT_CUTOFF = 1500 };
+
+  // divisor and quotient length (in limbs) from which division multiplies by
+  // a newton reciprocal instead of running knuth algorithm D
+  enum { NEWTON_CUTOFF = 150 };
+
+  // length (in limbs) below which decimal conversion works limb by limb
+  enum { CONVERSION_CUTOFF = 64 };
+
+ public:
+  // ==== Constructors ====
+
+  BigInt() : negative_(false) {}
+
+  template <typename Integer, typename = typename std::enable_if<
+                                  internal::is_integer<Integer>::value>::type>
+  BigInt(Integer value) : negative_(false) {
+    unsigned long long magnitude = (unsigned long long)value;
+    if (value < 0) {
+      negative_ = true;
+      magnitude = 0 - magnitude;
+    }
+    if (magnitude != 0) limbs_.push_back(magnitude);
+  }
+
+  // parse decimal string with optional leading sign
+  // throw std::invalid_argument if decimal is malformed
+  explicit BigInt(const std::string& decimal) : negative_(false) {
+    std::string::const_iterator first = decimal.begin(), last = decimal.end();
+    bool negative = false;
+    if (first != last && (*first == '-' || *first == '+')) {
+      negative = *first == '-';
+      ++first;
+    }
+    if (first == last) {
+      throw std::invalid_argument("BigInt(const std::string&): no digits");
+    }
+    for (std::string::const_iterator iter = first; iter != last; ++iter) {
+      if (*iter < '0' || *iter > '9') {
+        throw std::invalid_argument(
+            "BigInt(const std::string&): invalid digit");
+      }
+    }
+    std::vector<BigInt> powers;
+    parse_decimal(&*first, &*first + (last - first), powers, *this);
+    negative_ = negative && !is_zero();
+  }
+
+  explicit BigInt(const char* decimal) : BigInt(std::string(decimal)) {}
+
+  BigInt(const BigInt& other) = default;
+  BigInt(BigInt&& other)
+      : negative_(other.negative_), limbs_(std::move(other.limbs_)) {
+    other.negative_ = false;
+    other.limbs_.clear();
+  }
+
+  // ==== Assignment operator ====
+
+  BigInt& operator=(const BigInt& other) = default;
+  BigInt& operator=(BigInt&& other) {
+    if (this != &other) {
+      negative_ = other.negative_;
+      limbs_.swap(other.limbs_);
+      other.negative_ = false;
+      other.limbs_.clear();
+    }
+    return *this;
+  }
+
+  // ==== Observers ====
+
+  bool is_zero() const { return limbs_.empty(); }
+  bool negative() const { return negative_; }
+
+  // -1, 0 or 1
+  int sign() const { return is_zero() ? 0 : (negative_ ? -1 : 1); }
+
+  // magnitude limbs from low to high
+  const limb_vector& limbs() const { return limbs_; }
+
+  // number of bits in magnitude, 0 for zero
+  size_type bit_length() const {
+    if (is_zero()) return 0;
+    return limbs_.size() * 64 - count_leading_zeros(limbs_.back());
+  }
+
+  // decimal representation, with '-' for negative numbers
+  std::string to_string() const {
+    std::string result;
+    if (is_zero()) return "0";
+    std::vector<BigInt> powers, reciprocals;
+    to_decimal(limbs_, 0, powers, reciprocals, result);
+    if (negative_) result.insert(result.begin(), '-');
+    return result;
+  }
+
+  // ==== Arithmetric operators ====
+
+  BigInt operator-() const& {
+    BigInt result(*this);
+    result.negative_ = !result.negative_ && !result.is_zero();
+    return result;
+  }
+
+  BigInt operator-() && {
+    negative_ = !negative_ && !is_zero();
+    return std::move(*this);
+  }
+
+  BigInt& operator+=(const BigInt& other) {
+    return add_signed(other, other.negative_);
+  }
+
+  BigInt& operator-=(const BigInt& other) {
+    return add_signed(other, !other.negative_);
+  }
+
+  BigInt& operator*=(const BigInt& other) {
+    if (is_zero() || other.is_zero()) {
+      limbs_.clear();
+      negative_ = false;
+      return *this;
+    }
+    limb_vector product;
+    multiply(limbs_.data(), limbs_.size(), other.limbs_.data(),
+             other.limbs_.size(), product);
+    limbs_.swap(product);
+    negative_ = negative_ != other.negative_;
+    return *this;
+  }
+
+  // truncated division, quotient rounds toward zero
+  BigInt& operator/=(const BigInt& other) {
+    BigInt remainder;
+    divmod(*this, other, *this, remainder);
+    return *this;
+  }
+
+  // remainder has the sign of dividend
+  BigInt& operator%=(const BigInt& other) {
+    BigInt quotient;
+    divmod(*this, other, quotient, *this);
+    return *this;
+  }
+
+  // shifts scale the magnitude by 2^bits, sign is kept (so right shift
+  // rounds toward zero)
+  BigInt& operator<<=(size_type bits) {
+    shift_left(limbs_, bits);
+    return *this;
+  }
+
+  BigInt& operator>>=(size_type bits) {
+    shift_right(limbs_, bits);
+    if (is_zero()) negative_ = false;
+    return *this;
+  }
+
+  // pre-condition: divisor is not zero (throw std::domain_error otherwise)
+  // remarks: quotient and remainder may alias dividend or divisor
+  friend void divmod(const BigInt& dividend, const BigInt& divisor,
+                     BigInt& quotient, BigInt& remainder) {
+    if (divisor.is_zero()) {
+      throw std::domain_error("divmod(...): division by zero");
+    }
+    bool quotient_negative = dividend.negative_ != divisor.negative_;
+    bool remainder_negative = dividend.negative_;
+    limb_vector q, r;
+    divide(dividend.limbs_, divisor.limbs_, q, r);
+    quotient.limbs_.swap(q);
+    quotient.negative_ = quotient_negative && !quotient.is_zero();
+    remainder.limbs_.swap(r);
+    remainder.negative_ = remainder_negative && !remainder.is_zero();
+  }
+
+  // ==== Comparasion operators ====
+
+  // -1, 0 or 1 as lhs <, ==, > rhs
+  friend int compare(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.negative_ != rhs.negative_) return lhs.negative_ ? -1 : 1;
+    int result = compare_magnitude(lhs.limbs_, rhs.limbs_);
+    return lhs.negative_ ? -result : result;
+  }
+
+ private:
+  // ==== Magnitude operations ====
+
+  static int count_leading_zeros(limb_type limb) {
+    return limb == 0 ? 64 : __builtin_clzll(limb);
+  }
+
+  static void trim(limb_vector& limbs) {
+    while (!limbs.empty() && limbs.back() == 0) limbs.pop_back();
+  }
+
+  static int compare_magnitude(const limb_vector& lhs,
+                               const limb_vector& rhs) {
+    if (lhs.size() != rhs.size()) return lhs.size() < rhs.size() ? -1 : 1;
+    for (size_type i = lhs.size(); i-- > 0;) {
+      if (lhs[i] != rhs[i]) return lhs[i] < rhs[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  // target[0, len) += addend[0, addend_len), return carry out of target
+  static limb_type add_to(limb_type* target, size_type len,
+                          const limb_type* addend, size_type addend_len) {
+    limb_type carry = 0;
+    size_type i = 0;
+    for (; i < addend_len; ++i) {
+      double_limb_type sum = (double_limb_type)target[i] + addend[i] + carry;
+      target[i] = limb_type(sum);
+      carry = limb_type(sum >> 64);
+    }
+    for (; carry != 0 && i < len; ++i) carry = ++target[i] == 0;
+    return carry;
+  }
+
+  // target[0, len) -= subtrahend[0, subtrahend_len), return borrow
+  static limb_type subtract_from(limb_type* target, size_type len,
+                                 const limb_type* subtrahend,
+                                 size_type subtrahend_len) {
+    limb_type borrow = 0;
+    size_type i = 0;
+    for (; i < subtrahend_len; ++i) {
+      limb_type value = target[i], sub = subtrahend[i];
+      target[i] = value - sub - borrow;
+      borrow = value < sub || (value == sub && borrow);
+    }
+    for (; borrow != 0 && i < len; ++i) borrow = target[i]-- == 0;
+    return borrow;
+  }
+
+  // this = this + (other with sign negative), in place
+  BigInt& add_signed(const BigInt& other, bool other_negative) {
+    if (other.is_zero()) return *this;
+    if (&other == this) {  // x + x or x - x
+      if (other_negative == negative_) {
+        shift_left(limbs_, 1);
+      } else {
+        limbs_.clear();
+        negative_ = false;
+      }
+      return *this;
+    }
+    if (negative_ == other_negative || is_zero()) {
+      negative_ = other_negative;
+      if (limbs_.size() < other.limbs_.size())
+        limbs_.resize(other.limbs_.size(), 0);
+      limb_type carry = add_to(limbs_.data(), limbs_.size(),
+                               other.limbs_.data(), other.limbs_.size());
+      if (carry) limbs_.push_back(carry);
+      return *this;
+    }
+
+    int cmp = compare_magnitude(limbs_, other.limbs_);
+    if (cmp >= 0) {  // |this| - |other|, sign of this
+      subtract_from(limbs_.data(), limbs_.size(), other.limbs_.data(),
+                    other.limbs_.size());
+    } else {  // |other| - |this|, sign of other
+      limb_vector difference(other.limbs_);
+      subtract_from(difference.data(), difference.size(), limbs_.data(),
+                    limbs_.size());
+      limbs_.swap(difference);
+      negative_ = other_negative;
+    }
+    trim(limbs_);
+    if (is_zero()) negative_ = false;
+    return *this;
+  }
+
+  static void shift_left(limb_vector& limbs, size_type bits) {
+    if (limbs.empty() || bits == 0) return;
+    size_type limb_shift = bits / 64, bit_shift = bits % 64;
+    size_type old_size = limbs.size();
+    limbs.resize(old_size + limb_shift + 1, 0);
+    for (size_type i = old_size; i-- > 0;) {
+      limb_type value = limbs[i];
+      limbs[i] = 0;
+      if (bit_shift == 0) {
+        limbs[i + limb_shift] = value;
+      } else {
+        limbs[i + limb_shift + 1] |= value >> (64 - bit_shift);
+        limbs[i + limb_shift] = value << bit_shift;
+      }
+    }
+    trim(limbs);
+  }
+
+  static void shift_right(limb_vector& limbs, size_type bits) {
+    size_type limb_shift = bits / 64, bit_shift = bits % 64;
+    if (limb_shift >= limbs.size()) {
+      limbs.clear();
+      return;
+    }
+    size_type new_size = limbs.size() - limb_shift;
+    for (size_type i = 0; i < new_size; ++i) {
+      limb_type value = limbs[i + limb_shift] >> bit_shift;
+      if (bit_shift != 0 && i + limb_shift + 1 < limbs.size())
+        value |= limbs[i + limb_shift + 1] << (64 - bit_shift);
+      limbs[i] = value;
+    }
+    limbs.resize(new_size);
+    trim(limbs);
+  }
+
+  // result[0, len1 + len2) = lhs[0, len1) * rhs[0, len2)
+  static void schoolbook(const limb_type* lhs, size_type len1,
+                         const limb_type* rhs, size_type len2,
+                         limb_type* result) {
+    std::fill(result, result + len1 + len2, limb_type(0));
+    for (size_type i = 0; i < len1; ++i) {
+      limb_type carry = 0;
+      for (size_type j = 0; j < len2; ++j) {
+        double_limb_type value =
+            (double_limb_type)lhs[i] * rhs[j] + result[i + j] + carry;
+        result[i + j] = limb_type(value);
+        carry = limb_type(value >> 64);
+      }
+      result[i + len2] = carry;
+    }
+  }
+
+  // result[0, 2 * len) = lhs[0, len) * rhs[0, len)
+  static void karatsuba(const limb_type* lhs, const limb_type* rhs,
+                        size_type len, limb_type* result) {
+    if (len < KARATSUBA_CUTOFF) {
+      schoolbook(lhs, len, rhs, len, result);
+      return;
+    }
+
+    // x = low + high * B^low_len, high_len >= low_len
+    size_type low_len = len >> 1, high_len = len - low_len;
+    karatsuba(lhs, rhs, low_len, result);
+    karatsuba(lhs + low_len, rhs + low_len, high_len, result + 2 * low_len);
+
+    // middle = (low1 + high1) * (low2 + high2) - low - high
+    limb_vector sum1(lhs + low_len, lhs + len), sum2(rhs + low_len, rhs + len);
+    sum1.push_back(add_to(sum1.data(), high_len, lhs, low_len));
+    sum2.push_back(add_to(sum2.data(), high_len, rhs, low_len));
+    limb_vector middle(2 * high_len + 2);
+    karatsuba(sum1.data(), sum2.data(), high_len + 1, middle.data());
+    subtract_from(middle.data(), middle.size(), result, 2 * low_len);
+    subtract_from(middle.data(), middle.size(), result + 2 * low_len,
+                  2 * high_len);
+    size_type middle_len = middle.size();
+    while (middle_len > 0 && middle[middle_len - 1] == 0) --middle_len;
+    add_to(result + low_len, 2 * len - low_len, middle.data(), middle_len);
+  }
+
+  // result = lhs[0, len1) * rhs[0, len2) by number theoretic transform over
+  // 32 bit halves of limbs, return false if it can not be exact
+  static bool ntt_multiply(const limb_type* lhs, size_type len1,
+                           const limb_type* rhs, size_type len2,
+                           limb_vector& result) {
+    const double_limb_type half_max = 0xFFFFFFFFull;
+    double_limb_type shorter = 2 * std::min(len1, len2);
+    if (half_max * half_max > fft::ntt_convolve_limit() / shorter ||
+        2 * (len1 + len2) - 1 > fft::ntt_convolve_max_length()) {
+      return false;
+    }
+    std::vector<std::uint64_t> halves1(2 * len1), halves2(2 * len2);
+    for (size_type i = 0; i < len1; ++i) {
+      halves1[2 * i] = lhs[i] & 0xFFFFFFFFull;
+      halves1[2 * i + 1] = lhs[i] >> 32;
+    }
+    for (size_type i = 0; i < len2; ++i) {
+      halves2[2 * i] = rhs[i] & 0xFFFFFFFFull;
+      halves2[2 * i + 1] = rhs[i] >> 32;
+    }
+    std::vector<unsigned __int128> product(halves1.size() + halves2.size() - 1);
+    fft::ntt_convolve(halves1.begin(), halves1.end(), halves2.begin(),
+                      halves2.end(), product.begin());
+
+    // carry in base 2^32, two halves per limb
+    result.assign(len1 + len2, 0);
+    unsigned __int128 carry = 0;
+    for (size_type i = 0; i < 2 * (len1 + len2); ++i) {
+      if (i < product.size()) carry += product[i];
+      limb_type half = limb_type(carry) & 0xFFFFFFFFull;
+      result[i >> 1] |= (i & 0x01) ? half << 32 : half;
+      carry >>= 32;
+    }
+    return true;
+  }
+
+  // result = lhs[0, len1) * rhs[0, len2), sized len1 + len2 then trimmed
+  static void multiply(const limb_type* lhs, size_type len1,
+                       const limb_type* rhs, size_type len2,
+                       limb_vector& result) {
+    if (len1 < len2) {
+      std::swap(lhs, rhs);
+      std::swap(len1, len2);
+    }
+    if (len2 < KARATSUBA_CUTOFF) {
+      result.resize(len1 + len2);
+      schoolbook(lhs, len1, rhs, len2, result.data());
+    } else if (len2 < NTT_CUTOFF ||
+               !ntt_multiply(lhs, len1, rhs, len2, result)) {
+      // karatsuba on pieces of the longer operand
+      result.assign(len1 + len2, 0);
+      limb_vector piece(len2), product(2 * len2);
+      for (size_type pos = 0; pos < len1; pos += len2) {
+        size_type piece_len = std::min(len2, len1 - pos);
+        std::copy(lhs + pos, lhs + pos + piece_len, piece.begin());
+        std::fill(piece.begin() + piece_len, piece.end(), limb_type(0));
+        karatsuba(piece.data(), rhs, len2, product.data());
+        size_type product_len = std::min(product.size(), result.size() - pos);
+        add_to(result.data() + pos, result.size() - pos, product.data(),
+               product_len);
+      }
+    }
+    trim(result);
+  }
+
+  // quotient = dividend / divisor, remainder = dividend % divisor,
+  // magnitudes only
+  // pre-condition: divisor is not empty
+  static void divide(const limb_vector& dividend, const limb_vector& divisor,
+                     limb_vector& quotient, limb_vector& remainder) {
+    if (divisor.size() >= NEWTON_CUTOFF &&
+        dividend.size() >= divisor.size() + NEWTON_CUTOFF) {
+      BigInt v;
+      v.limbs_ = divisor;
+      divide_newton(dividend, v, reciprocal(v), quotient, remainder);
+    } else {
+      divide_knuth(dividend, divisor, quotient, remainder);
+    }
+  }
+
+  // knuth algorithm D, see divide()
+  static void divide_knuth(const limb_vector& dividend,
+                           const limb_vector& divisor, limb_vector& quotient,
+                           limb_vector& remainder) {
+    if (compare_magnitude(dividend, divisor) < 0) {
+      remainder = dividend;
+      quotient.clear();
+      return;
+    }
+    size_type n = divisor.size(), m = dividend.size() - n;
+    if (n == 1) {  // single limb divisor
+      limb_type d = divisor[0], rest = 0;
+      quotient.resize(dividend.size());
+      for (size_type i = dividend.size(); i-- > 0;) {
+        double_limb_type value = ((double_limb_type)rest << 64) | dividend[i];
+        quotient[i] = limb_type(value / d);
+        rest = limb_type(value % d);
+      }
+      trim(quotient);
+      remainder.clear();
+      if (rest != 0) remainder.push_back(rest);
+      return;
+    }
+
+    // normalize so that top bit of divisor is set
+    int shift = count_leading_zeros(divisor.back());
+    limb_vector v(divisor), u(dividend);
+    u.push_back(0);
+    if (shift > 0) {
+      for (size_type i = n; i-- > 1;)
+        v[i] = (v[i] << shift) | (v[i - 1] >> (64 - shift));
+      v[0] <<= shift;
+      for (size_type i = u.size(); i-- > 1;)
+        u[i] = (u[i] << shift) | (u[i - 1] >> (64 - shift));
+      u[0] <<= shift;
+    }
+
+    limb_vector q(m + 1);
+    const double_limb_type base = (double_limb_type)1 << 64;
+    for (size_type j = m + 1; j-- > 0;) {
+      // estimate quotient digit from top two limbs
+      double_limb_type numerator = ((double_limb_type)u[j + n] << 64) |
+                                   u[j + n - 1];
+      double_limb_type qhat = numerator / v[n - 1];
+      double_limb_type rhat = numerator % v[n - 1];
+      while (qhat >= base ||
+             qhat * v[n - 2] > ((rhat << 64) | u[j + n - 2])) {
+        --qhat;
+        rhat += v[n - 1];
+        if (rhat >= base) break;
+      }
+
+      // multiply and subtract
+      __int128 borrow = 0, t = 0;
+      for (size_type i = 0; i < n; ++i) {
+        double_limb_type p = qhat * v[i];
+        t = (__int128)u[i + j] - borrow - (__int128)(limb_type)p;
+        u[i + j] = limb_type(t);
+        borrow = (__int128)(p >> 64) - (t >> 64);
+      }
+      t = (__int128)u[j + n] - borrow;
+      u[j + n] = limb_type(t);
+
+      q[j] = limb_type(qhat);
+      if (t < 0) {  // estimated one too large, add back
+        --q[j];
+        limb_type carry = add_to(u.data() + j, n, v.data(), n);
+        u[j + n] += carry;
+      }
+    }
+
+    // unnormalize remainder
+    remainder.assign(u.begin(), u.begin() + n);
+    if (shift > 0) {
+      for (size_type i = 0; i + 1 < n; ++i) {
+        remainder[i] =
+            (remainder[i] >> shift) | (remainder[i + 1] << (64 - shift));
+      }
+      remainder[n - 1] >>= shift;
+    }
+    trim(remainder);
+    quotient.swap(q);
+    trim(quotient);
+  }
+
+  // floor(B^(2n) / v), B = 2^64, n = v.limbs().size(), by newton iteration
+  // from the reciprocal of the top half of v
+  static BigInt reciprocal(const BigInt& v) {
+    size_type n = v.limbs_.size();
+    BigInt result;
+    if (n < NEWTON_CUTOFF) {
+      limb_vector numerator(2 * n + 1, 0), remainder;
+      numerator.back() = 1;
+      divide_knuth(numerator, v.limbs_, result.limbs_, remainder);
+      return result;
+    }
+
+    // top h limbs carry relative error below B^-(h-1), one newton step
+    // squares it, h > n/2 + 1 leaves an absolute error of a few units
+    size_type h = n / 2 + 2, low = n - h;
+    BigInt top;
+    top.limbs_.assign(v.limbs_.begin() + low, v.limbs_.end());
+    result = reciprocal(top);
+    result <<= 64 * low;
+
+    // result += result * (B^(2n) - v * result) / B^(2n)
+    BigInt unit(1), error, product;
+    unit <<= 128 * n;
+    error = unit;
+    product = v;
+    product *= result;
+    error -= product;
+    product = result;
+    product *= error;
+    product >>= 128 * n;
+    result += product;
+
+    // correct remaining units: 0 <= B^(2n) - v * result < v
+    error = unit;
+    product = v;
+    product *= result;
+    error -= product;
+    while (error.negative_) {
+      result -= 1;
+      error += v;
+    }
+    while (compare(error, v) >= 0) {
+      result += 1;
+      error -= v;
+    }
+    return result;
+  }
+
+  // divide() by long division in blocks of n = v.limbs().size() limbs, each
+  // block quotient estimated by multiplying with reciprocal(v)
+  static void divide_newton(const limb_vector& dividend, const BigInt& v,
+                            const BigInt& reciprocal, limb_vector& quotient,
+                            limb_vector& remainder) {
+    size_type n = v.limbs_.size();
+    size_type blocks = (dividend.size() + n - 1) / n;
+    limb_vector q(blocks * n, 0);
+    BigInt rest;
+    for (size_type b = blocks; b-- > 0;) {
+      // current = rest * B^n + block, less than v * B^n
+      BigInt current;
+      size_type end = std::min(dividend.size(), (b + 1) * n);
+      current.limbs_.assign(dividend.begin() + b * n, dividend.begin() + end);
+      current.limbs_.resize(n, 0);
+      current.limbs_.insert(current.limbs_.end(), rest.limbs_.begin(),
+                            rest.limbs_.end());
+      trim(current.limbs_);
+
+      BigInt estimate(current), product;
+      estimate *= reciprocal;
+      estimate >>= 128 * n;
+      rest = current;
+      product = estimate;
+      product *= v;
+      rest -= product;
+      while (rest.negative_) {
+        estimate -= 1;
+        rest += v;
+      }
+      while (compare(rest, v) >= 0) {
+        estimate += 1;
+        rest -= v;
+      }
+      std::copy(estimate.limbs_.begin(), estimate.limbs_.end(),
+                q.begin() + b * n);
+    }
+    trim(q);
+    quotient.swap(q);
+    remainder.swap(rest.limbs_);
+  }
+
+  // ==== Decimal conversion ====
+
+  // 10^19, the largest power of 10 in a limb
+  static limb_type chunk_base() { return 10000000000000000000ull; }
+  enum { CHUNK_DIGITS = 19 };
+
+  // powers[k] = 10^(19 * 2^k), extended on demand
+  static const BigInt& power(std::vector<BigInt>& powers, size_type k) {
+    if (powers.empty()) powers.push_back(BigInt(chunk_base()));
+    while (powers.size() <= k) {
+      BigInt square(powers.back());
+      square *= powers.back();
+      powers.push_back(std::move(square));
+    }
+    return powers[k];
+  }
+
+  // parse decimal digits [first, last) into magnitude of result
+  static void parse_decimal(const char* first, const char* last,
+                            std::vector<BigInt>& powers, BigInt& result) {
+    size_type len = last - first;
+    if (len <= CHUNK_DIGITS * CONVERSION_CUTOFF) {
+      result.limbs_.clear();
+      size_type head = len % CHUNK_DIGITS;
+      if (head == 0) head = CHUNK_DIGITS;
+      for (const char* pos = first; pos != last; head = CHUNK_DIGITS) {
+        limb_type chunk = 0, scale = 1;
+        for (size_type i = 0; i < head; ++i, ++pos) {
+          chunk = chunk * 10 + limb_type(*pos - '0');
+          scale *= 10;
+        }
+        // result = result * scale + chunk
+        limb_type carry = chunk;
+        for (size_type i = 0; i < result.limbs_.size(); ++i) {
+          double_limb_type value =
+              (double_limb_type)result.limbs_[i] * scale + carry;
+          result.limbs_[i] = limb_type(value);
+          carry = limb_type(value >> 64);
+        }
+        if (carry != 0) result.limbs_.push_back(carry);
+      }
+      return;
+    }
+
+    // value = high * 10^(19 * 2^k) + low, with low taking 19 * 2^k digits
+    size_type k = 0;
+    while (CHUNK_DIGITS * (size_type(2) << k) < len) ++k;
+    size_type low_len = CHUNK_DIGITS * (size_type(1) << k);
+    BigInt low;
+    parse_decimal(last - low_len, last, powers, low);
+    parse_decimal(first, last - low_len, powers, result);
+    result *= power(powers, k);
+    result += low;
+  }
+
+  // append decimal digits of magnitude to result, zero padded to width
+  // reciprocals[k] caches reciprocal(powers[k]) for large powers
+  static void to_decimal(const limb_vector& magnitude, size_type width,
+                         std::vector<BigInt>& powers,
+                         std::vector<BigInt>& reciprocals,
+                         std::string& result) {
+    if (magnitude.size() <= CONVERSION_CUTOFF) {
+      // chunks of 19 digits from low to high
+      limb_vector rest(magnitude);
+      std::vector<limb_type> chunks;
+      while (!rest.empty()) {
+        limb_type remainder = 0;
+        for (size_type i = rest.size(); i-- > 0;) {
+          double_limb_type value =
+              ((double_limb_type)remainder << 64) | rest[i];
+          rest[i] = limb_type(value / chunk_base());
+          remainder = limb_type(value % chunk_base());
+        }
+        trim(rest);
+        chunks.push_back(remainder);
+      }
+      std::string digits;
+      for (size_type i = chunks.size(); i-- > 0;) {
+        std::string chunk = std::to_string(chunks[i]);
+        if (i + 1 != chunks.size())
+          digits.append(CHUNK_DIGITS - chunk.size(), '0');
+        digits += chunk;
+      }
+      if (chunks.empty()) digits = "0";
+      if (width > digits.size()) result.append(width - digits.size(), '0');
+      result += digits;
+      return;
+    }
+
+    // magnitude = high * 10^(19 * 2^k) + low, split near half size
+    size_type k = 0;
+    while (2 * power(powers, k + 1).limbs_.size() <= magnitude.size() + 1) ++k;
+    size_type low_width = CHUNK_DIGITS * (size_type(1) << k);
+    limb_vector high, low;
+    const BigInt& divisor = power(powers, k);
+    if (divisor.limbs_.size() >= NEWTON_CUTOFF) {
+      if (reciprocals.size() <= k) reciprocals.resize(k + 1);
+      if (reciprocals[k].is_zero()) reciprocals[k] = reciprocal(divisor);
+      divide_newton(magnitude, divisor, reciprocals[k], high, low);
+    } else {
+      divide_knuth(magnitude, divisor.limbs_, high, low);
+    }
+    if (high.empty()) {
+      if (width > low_width) result.append(width - low_width, '0');
+    } else {
+      to_decimal(high, width > low_width ? width - low_width : 0, powers,
+                 reciprocals, result);
+    }
+    to_decimal(low, high.empty() && width < low_width ? width : low_width,
+               powers, reciprocals, result);
+  }
+
+ private:
+  bool negative_;
+  limb_vector limbs_;
+};
+
+// ==== Arithmetric operators ====
+
+inline BigInt operator+(const BigInt& lhs, const BigInt& rhs) {
+  BigInt result(lhs);
+  return result += rhs;
+}
+
+inline BigInt operator+(BigInt&& lhs, const BigInt& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator+(const BigInt& lhs, BigInt&& rhs) {
+  rhs += lhs;
+  return std::move(rhs);
+}
+
+inline BigInt operator+(BigInt&& lhs, BigInt&& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator-(const BigInt& lhs, const BigInt& rhs) {
+  BigInt result(lhs);
+  return result -= rhs;
+}
+
+inline BigInt operator-(BigInt&& lhs, const BigInt& rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator-(const BigInt& lhs, BigInt&& rhs) {
+  // lhs - rhs == -(rhs - lhs)
+  rhs -= lhs;
+  return -std::move(rhs);
+}
+
+inline BigInt operator-(BigInt&& lhs, BigInt&& rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator*(const BigInt& lhs, const BigInt& rhs) {
+  BigInt result(lhs);
+  return result *= rhs;
+}
+
+inline BigInt operator*(BigInt&& lhs, const BigInt& rhs) {
+  lhs *= rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator*(const BigInt& lhs, BigInt&& rhs) {
+  rhs *= lhs;
+  return std::move(rhs);
+}
+
+inline BigInt operator*(BigInt&& lhs, BigInt&& rhs) {
+  lhs *= rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator/(const BigInt& lhs, const BigInt& rhs) {
+  BigInt result(lhs);
+  return result /= rhs;
+}
+
+inline BigInt operator/(BigInt&& lhs, const BigInt& rhs) {
+  lhs /= rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator%(const BigInt& lhs, const BigInt& rhs) {
+  BigInt result(lhs);
+  return result %= rhs;
+}
+
+inline BigInt operator%(BigInt&& lhs, const BigInt& rhs) {
+  lhs %= rhs;
+  return std::move(lhs);
+}
+
+inline BigInt operator<<(const BigInt& lhs, std::size_t bits) {
+  BigInt result(lhs);
+  return result <<= bits;
+}
+
+inline BigInt operator<<(BigInt&& lhs, std::size_t bits) {
+  lhs <<= bits;
+  return std::move(lhs);
+}
+
+inline BigInt operator>>(const BigInt& lhs, std::size_t bits) {
+  BigInt result(lhs);
+  return result >>= bits;
+}
+
+inline BigInt operator>>(BigInt&& lhs, std::size_t bits) {
+  lhs >>= bits;
+  return std::move(lhs);
+}
+
+// ==== Comparasion operators ====
+
+inline bool operator==(const BigInt& lhs, const BigInt& rhs) {
+  return lhs.negative() == rhs.negative() && lhs.limbs() == rhs.limbs();
+}
+
+inline bool operator!=(const BigInt& lhs, const BigInt& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator<(const BigInt& lhs, const BigInt& rhs) {
+  return compare(lhs, rhs) < 0;
+}
+
+inline bool operator>(const BigInt& lhs, const BigInt& rhs) {
+  return rhs < lhs;
+}
+
+inline bool operator<=(const BigInt& lhs, const BigInt& rhs) {
+  return !(rhs < lhs);
+}
+
+inline bool operator>=(const BigInt& lhs, const BigInt& rhs) {
+  return !(lhs < rhs);
+}
+
+inline std::ostream& operator<<(std::ostream& os, const BigInt& value) {
+  return os << value.to_string();
+}
+
 }  // namespace bignumber
 
 #endif  // BIGNUMBER_H_
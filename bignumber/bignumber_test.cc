@@ -1,8 +1,11 @@
 #include "bignumber/bignumber.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -56,3 +59,179 @@ TEST(BigNumberTest, Multiplies) {
   TestMultiplies(1234, 42);
   TestMultiplies(10054, 38722);
 }
+
+template <typename DigitT>
+void TestMultipliesLong(std::size_t len1, std::size_t len2, DigitT round) {
+  std::vector<DigitT> num1(len1), num2(len2);
+  unsigned long long seed = len1 * 31 + len2;
+  for (std::size_t i = 0; i < len1; ++i) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    num1[i] = DigitT((seed >> 16) % round);
+  }
+  for (std::size_t i = 0; i < len2; ++i) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    num2[i] = DigitT((seed >> 16) % round);
+  }
+  num1.back() = num2.back() = round - 1;  // full length operands
+
+  // existing digits in result are accumulated
+  std::vector<DigitT> expected(len1 + len2 + 1, 0), result(len1 + len2 + 1, 0);
+  expected[0] = result[0] = round - 1;
+  typename std::vector<DigitT>::iterator expected_end =
+      bignumber::internal::schoolbook_multiplies(num1.begin(), num1.end(),
+                                                 num2.begin(), num2.end(),
+                                                 round, expected.begin());
+  typename std::vector<DigitT>::iterator result_end = bignumber::multiplies(
+      num1.begin(), num1.end(), num2.begin(), num2.end(), round,
+      result.begin());
+  EXPECT_EQ(result_end - result.begin(), expected_end - expected.begin())
+      << "len1=" << len1 << " len2=" << len2 << " round=" << round;
+  EXPECT_EQ(result, expected)
+      << "len1=" << len1 << " len2=" << len2 << " round=" << round;
+}
+
+TEST(BigNumberTest, MultipliesLong) {
+  // karatsuba
+  TestMultipliesLong<int>(40, 40, 10);
+  TestMultipliesLong<int>(100, 37, 10);
+  TestMultipliesLong<int>(333, 700, 10000);
+  TestMultipliesLong<unsigned long long>(513, 200, 1000000000);
+  // number theoretic transform
+  TestMultipliesLong<int>(1500, 1024, 10);
+  TestMultipliesLong<int>(5000, 3001, 2);
+  TestMultipliesLong<long long>(2000, 2000, 1 << 16);
+  TestMultipliesLong<unsigned long long>(1100, 4000, 4294967296ull);
+}
+
+TEST(BigNumberTest, MultipliesCarry) {
+  // 99...9 * 99...9 == 99...980...01
+  const std::size_t len = 3000;
+  std::vector<int> num(len, 9), result(2 * len, 0);
+  std::vector<int>::iterator end = bignumber::multiplies(
+      num.begin(), num.end(), num.begin(), num.end(), 10, result.begin());
+  EXPECT_EQ(end, result.end());
+  EXPECT_EQ(result[0], 1);
+  EXPECT_EQ(std::count(result.begin() + 1, result.begin() + len, 0), len - 1);
+  EXPECT_EQ(result[len], 8);
+  EXPECT_EQ(std::count(result.begin() + len + 1, result.end(), 9), len - 1);
+}
+
+using bignumber::BigInt;
+
+TEST(BigIntTest, Construct) {
+  EXPECT_EQ(BigInt().to_string(), "0");
+  EXPECT_EQ(BigInt(0).sign(), 0);
+  EXPECT_EQ(BigInt(-42).to_string(), "-42");
+  EXPECT_EQ(BigInt(18446744073709551615ull).to_string(),
+            "18446744073709551615");
+  EXPECT_EQ(BigInt(-9223372036854775807ll - 1).to_string(),
+            "-9223372036854775808");
+  EXPECT_EQ(BigInt("-000123").to_string(), "-123");
+  EXPECT_EQ(BigInt("+99").to_string(), "99");
+  EXPECT_EQ(BigInt("-0").sign(), 0);
+  EXPECT_EQ(BigInt("18446744073709551616").limbs(),
+            std::vector<std::uint64_t>({0, 1}));
+  EXPECT_THROW(BigInt(""), std::invalid_argument);
+  EXPECT_THROW(BigInt("-"), std::invalid_argument);
+  EXPECT_THROW(BigInt("12a"), std::invalid_argument);
+
+  BigInt a(7), b(std::move(a));
+  EXPECT_TRUE(a.is_zero());
+  EXPECT_EQ(b, BigInt(7));
+
+  // small integers convert, bool and characters do not
+  EXPECT_EQ(BigInt(std::int8_t(-5)).to_string(), "-5");
+  EXPECT_EQ(BigInt(std::uint8_t(200)).to_string(), "200");
+  EXPECT_FALSE((std::is_convertible<bool, BigInt>::value));
+  EXPECT_FALSE((std::is_convertible<char, BigInt>::value));
+  EXPECT_FALSE((std::is_convertible<char32_t, BigInt>::value));
+}
+
+TEST(BigIntTest, AddSubtract) {
+  BigInt a("18446744073709551615"), one(1);
+  EXPECT_EQ((a + one).to_string(), "18446744073709551616");
+  EXPECT_EQ((a + one - one), a);
+  EXPECT_EQ((one - a).to_string(), "-18446744073709551614");
+  EXPECT_EQ((-a - a).to_string(), "-36893488147419103230");
+  EXPECT_EQ((a - a).sign(), 0);
+  EXPECT_EQ((BigInt(-5) + BigInt(3)).to_string(), "-2");
+  EXPECT_EQ((BigInt(-5) + BigInt(8)).to_string(), "3");
+  EXPECT_EQ((BigInt(5) - BigInt(-8)).to_string(), "13");
+  BigInt c(10);
+  c += c;
+  EXPECT_EQ(c, BigInt(20));
+  c -= c;
+  EXPECT_EQ(c.sign(), 0);
+  EXPECT_FALSE(c.negative());
+}
+
+TEST(BigIntTest, Compare) {
+  EXPECT_LT(BigInt(-3), BigInt(2));
+  EXPECT_LT(BigInt(-3), BigInt(-2));
+  EXPECT_GT(BigInt("100000000000000000000"), BigInt(99));
+  EXPECT_LE(BigInt(0), BigInt(-0));
+  EXPECT_NE(BigInt(1), BigInt(-1));
+}
+
+TEST(BigIntTest, MultiplyDivide) {
+  BigInt a("123456789012345678901234567890");
+  BigInt b("-987654321098765432109876543210");
+  BigInt product = a * b;
+  EXPECT_EQ(product.to_string(),
+            "-121932631137021795226185032733622923332237463801111263526900");
+  EXPECT_EQ(product / b, a);
+  EXPECT_EQ(product % b, BigInt(0));
+  EXPECT_EQ(((-product + 17) % a).to_string(), "17");
+  EXPECT_EQ(((product - 17) % a).to_string(), "-17");
+
+  // truncated division
+  EXPECT_EQ(BigInt(-7) / BigInt(2), BigInt(-3));
+  EXPECT_EQ(BigInt(-7) % BigInt(2), BigInt(-1));
+  EXPECT_EQ(BigInt(7) / BigInt(-2), BigInt(-3));
+  EXPECT_EQ(BigInt(7) % BigInt(-2), BigInt(1));
+  EXPECT_THROW(a / BigInt(0), std::domain_error);
+
+  BigInt q, r;
+  divmod(a, BigInt(1000), q, r);
+  EXPECT_EQ(q.to_string(), "123456789012345678901234567");
+  EXPECT_EQ(r.to_string(), "890");
+}
+
+TEST(BigIntTest, Shift) {
+  BigInt a(3);
+  EXPECT_EQ((a << 200).to_string(),
+            "4820814132776970826625886277023487807566608981348378505904128");
+  EXPECT_EQ((a << 200) >> 199, BigInt(6));
+  EXPECT_EQ((a << 64).limbs(), std::vector<std::uint64_t>({0, 3}));
+  EXPECT_EQ((BigInt(-5) >> 1), BigInt(-2));
+  EXPECT_EQ((a >> 2).sign(), 0);
+  EXPECT_EQ((a << 130).bit_length(), 132);
+}
+
+TEST(BigIntTest, LargeOperands) {
+  // (10^n - 1)^2 == 10^2n - 2 * 10^n + 1 over every multiplication method
+  for (std::size_t n : {50, 1000, 5000, 40000}) {
+    BigInt nines(std::string(n, '9'));
+    std::string expected = std::string(n - 1, '9') + "8" +
+                           std::string(n - 1, '0') + "1";
+    BigInt square = nines * nines;
+    EXPECT_EQ(square.to_string(), expected) << "n=" << n;
+    EXPECT_EQ(square, BigInt(expected)) << "n=" << n;
+
+    BigInt q, r;
+    divmod(square + BigInt(12345), nines, q, r);
+    EXPECT_EQ(q, nines) << "n=" << n;
+    EXPECT_EQ(r, BigInt(12345)) << "n=" << n;
+  }
+
+  // multiplication methods agree on random operands
+  BigInt x(1), y(1);
+  for (int i = 0; i < 4000; ++i) {
+    x = x * BigInt(6364136223846793005ull) + BigInt(i);
+    if (i % 3 == 0) y = y * BigInt(1442695040888963407ull) - BigInt(i);
+  }
+  BigInt z = x * y;
+  EXPECT_EQ(z / x, y);
+  EXPECT_EQ(z / y, x);
+  EXPECT_EQ(BigInt(z.to_string()), z);
+}
@@ -2,14 +2,130 @@
 #ifndef BM_H_
 #define BM_H_
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
+#include <istream>
 #include <iterator>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "parallel/parallel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace bm {
 
+namespace internal {
+// whether T is a byte type, whose bad character table is a flat array.
+// bool is left out, std::vector<bool> is not laid out as bytes
+template <typename T>
+struct is_byte
+    : std::integral_constant<bool, sizeof(T) == 1 &&
+                                       std::is_integral<T>::value &&
+                                       !std::is_same<T, bool>::value> {};
+
+// bad character table, maps an element to its distance from the last one
+// of the subsequence at its rightmost occurrence
+template <typename T, bool Byte = is_byte<T>::value>
+class BadCharacterTable {
+ public:
+  typedef std::size_t size_type;
+
+  void clear() { table_.clear(); }
+  size_type& operator[](const T& elem) { return table_[elem]; }
+  // distance of /elem/, /otherwise/ if absent
+  size_type find(const T& elem, size_type otherwise) const {
+    typename std::unordered_map<T, size_type>::const_iterator iter =
+        table_.find(elem);
+    return iter != table_.end() ? iter->second : otherwise;
+  }
+
+ private:
+  std::unordered_map<T, size_type> table_;
+};
+
+template <typename T>
+class BadCharacterTable<T, true> {
+ public:
+  typedef std::size_t size_type;
+
+  constexpr BadCharacterTable() : table_() { clear(); }
+
+  constexpr void clear() {
+    for (size_type i = 0; i < 256; ++i) table_[i] = ABSENT;
+  }
+  constexpr size_type& operator[](const T& elem) {
+    return table_[static_cast<unsigned char>(elem)];
+  }
+  constexpr size_type find(const T& elem, size_type otherwise) const {
+    size_type shift = table_[static_cast<unsigned char>(elem)];
+    return shift != ABSENT ? shift : otherwise;
+  }
+
+ private:
+  static constexpr size_type ABSENT = static_cast<size_type>(-1);
+  size_type table_[256];
+};
+
+// fill /table/ as bad character table of subsequence [first, first + m)
+template <typename RandomAccessIterator, typename Table>
+constexpr void make_bad_character(RandomAccessIterator first, std::size_t m,
+                                  Table& table) {
+  table.clear();
+  for (std::size_t i = 0; i < m; ++i) table[first[i]] = m - 1 - i;
+}
+
+// fill /table/ as good suffix table of subsequence [first, first + m) in
+// O(m), with /suffix/ as working space of m elements
+// table[i] is how far the text position goes ahead when subseq[i]
+// mismatches after (i, m) matched, that is (m - 1 - i) plus the shift of
+// the subsequence by the strong good suffix rule.
+template <typename RandomAccessIterator, typename Table>
+constexpr void make_good_suffix(RandomAccessIterator first, std::size_t m,
+                                Table& suffix, Table& table) {
+  typedef std::ptrdiff_t difference_type;
+  const difference_type n = m;
+  if (0 == n) {
+    table[0] = 1;
+    return;
+  }
+
+  // suffix[i] is the length of the longest common suffix of subsequence
+  // and its prefix [0, i]
+  suffix[n - 1] = n;
+  for (difference_type i = n - 2, f = n - 1, g = n - 1; i >= 0; --i) {
+    if (i > g && static_cast<difference_type>(suffix[i + n - 1 - f]) < i - g) {
+      suffix[i] = suffix[i + n - 1 - f];
+    } else {
+      if (i < g) g = i;
+      f = i;
+      while (g >= 0 && first[g] == first[g + n - 1 - f]) --g;
+      suffix[i] = f - g;
+    }
+  }
+
+  // shifts: by a prefix which is also a suffix, then by inner occurrences
+  for (difference_type i = 0; i < n; ++i) table[i] = n;
+  for (difference_type i = n - 1, j = 0; i >= 0; --i) {
+    if (static_cast<difference_type>(suffix[i]) == i + 1) {
+      for (; j < n - 1 - i; ++j) {
+        if (static_cast<difference_type>(table[j]) == n) table[j] = n - 1 - i;
+      }
+    }
+  }
+  for (difference_type i = 0; i + 1 < n; ++i) {
+    table[n - 1 - suffix[i]] = n - 1 - i;
+  }
+  for (difference_type i = 0; i < n; ++i) table[i] += n - 1 - i;
+}
+}  // namespace internal
+
 // abstraction for a subsequence, provide BM algorithm support data structure
 // =============================================================================
 template <typename T>
@@ -20,7 +136,7 @@ class Subsequence {
   typedef std::ptrdiff_t difference_type;
   typedef typename std::vector<value_type>::const_iterator iterator;
   typedef typename std::vector<value_type>::const_reference reference;
-  typedef std::unordered_map<value_type, size_type> BadCharacterDictionary;
+  typedef internal::BadCharacterTable<value_type> BadCharacterDictionary;
   typedef std::vector<size_type> GoodSuffixTable;
 
  public:
@@ -37,6 +153,7 @@ class Subsequence {
   iterator end() const { return subseq_.end(); }
   size_type size() const { return subseq_.size(); }
   reference operator[](size_type n) const { return subseq_[n]; }
+  const value_type* data() const { return subseq_.data(); }
 
   // good suffix parameter of position n
   // pre-condition: 0 <= n < size()
@@ -44,9 +161,7 @@ class Subsequence {
 
   // bad character parameter observer
   inline size_type bad_character(const value_type& elem) const {
-    typename BadCharacterDictionary::const_iterator iter =
-        badc_dict_.find(elem);
-    return iter != badc_dict_.end() ? iter->second : size();
+    return badc_dict_.find(elem, size());
   }
 
  public:
@@ -59,10 +174,7 @@ class Subsequence {
     if (first >= last) {
       return;
     }
-    size_type seqlen = last - first;
-    for (size_type i = 0; i < seqlen; ++i, ++first) {
-      badc_dict[*first] = seqlen - 1 - i;
-    }
+    internal::make_bad_character(first, last - first, badc_dict);
   }
 
   // make good suffix table of subsequence [first, last)
@@ -70,44 +182,10 @@ class Subsequence {
   static void make_good_suffix(RandomAccessIterator first,
                                RandomAccessIterator last,
                                GoodSuffixTable& goods_table) {
-    goods_table.clear();
-    if (first >= last) {
-      goods_table.push_back(1);
-      return;
-    }
-
-    // initialize good suffix table
-    size_type seqlen = last - first;
-    goods_table.resize(seqlen, seqlen);  // all initialized as seqlen
-    goods_table.back() = 1;              // last element initialized as 1
-
-    // calculate pre-calculate data for good suffix table
-    size_type max_sub_len = 0;
-    GoodSuffixTable& pre_table = goods_table;
-    for (size_type i = seqlen - 1; i > 0; --i) {
-      for (size_type j = 0; j < i; ++j) {
-        if (!std::equal(first + i, last, first + j)) {
-          continue;
-        }
-        if (0 == j) {
-          max_sub_len = seqlen - i;
-        } else if (first[i - 1] != first[j - 1]) {
-          pre_table[i - 1] = j - 1;
-        }
-      }
-    }
-
-    // calculate good suffix table by pre-calculate data
-    for (size_type i = 0; i < seqlen - 1; ++i) {
-      if (pre_table[i] != seqlen) {
-        goods_table[i] = seqlen - 1 - pre_table[i];
-      } else {
-        goods_table[i] = seqlen - 1 - i + pre_table[i];
-        if (max_sub_len != 0 && seqlen - 1 - i >= max_sub_len) {
-          goods_table[i] -= max_sub_len;
-        }
-      }
-    }
+    size_type seqlen = first < last ? last - first : 0;
+    GoodSuffixTable suffix(seqlen);
+    goods_table.assign(seqlen > 0 ? seqlen : 1, 0);
+    internal::make_good_suffix(first, seqlen, suffix, goods_table);
   }
 
  private:
@@ -116,13 +194,121 @@ class Subsequence {
   GoodSuffixTable goods_table_;
 };
 
+// subsequence of N bytes fixed at compile time, tables are built in
+// constant expressions:
+//   constexpr auto needle = bm::make_subsequence("needle");
+// =============================================================================
+template <typename T, std::size_t N>
+class FixedSubsequence {
+  static_assert(internal::is_byte<T>::value,
+                "FixedSubsequence: byte element type required");
+
+ public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+  typedef const value_type* iterator;
+  typedef const value_type& reference;
+
+ public:
+  // construct with subsequence [first, first + N)
+  constexpr explicit FixedSubsequence(const value_type* first)
+      : subseq_(), badc_dict_(), goods_table_() {
+    for (size_type i = 0; i < N; ++i) subseq_[i] = first[i];
+    internal::make_bad_character(subseq_, N, badc_dict_);
+    size_type suffix[N > 0 ? N : 1] = {};
+    internal::make_good_suffix(subseq_, N, suffix, goods_table_);
+  }
+
+  constexpr iterator begin() const { return subseq_; }
+  constexpr iterator end() const { return subseq_ + N; }
+  constexpr size_type size() const { return N; }
+  constexpr reference operator[](size_type n) const { return subseq_[n]; }
+  constexpr const value_type* data() const { return subseq_; }
+  constexpr size_type good_suffix(size_type n) const {
+    return goods_table_[n];
+  }
+  constexpr size_type bad_character(const value_type& elem) const {
+    return badc_dict_.find(elem, N);
+  }
+
+ private:
+  value_type subseq_[N > 0 ? N : 1];
+  internal::BadCharacterTable<value_type> badc_dict_;
+  size_type goods_table_[N > 0 ? N : 1];
+};
+
+// fixed subsequence of a string literal, without its terminating null
+template <std::size_t N>
+constexpr FixedSubsequence<char, N - 1> make_subsequence(
+    const char (&literal)[N]) {
+  return FixedSubsequence<char, N - 1>(literal);
+}
+
 // free functions
 // =============================================================================
-// find the 1st occurrence of subseq in sequence [first, last),
-//	return last if not found
-template <typename RandomAccessIterator, typename T>
-RandomAccessIterator find(RandomAccessIterator first, RandomAccessIterator last,
-                          const Subsequence<T>& subseq) {
+namespace internal {
+// whether [first, last) is byte elements of type T laid out contiguously,
+// which can be scanned as raw memory
+template <typename RandomAccessIterator, typename T,
+          typename V = typename std::remove_cv<typename std::iterator_traits<
+              RandomAccessIterator>::value_type>::type>
+struct is_byte_range
+    : std::integral_constant<
+          bool,
+          is_byte<T>::value && std::is_same<V, T>::value &&
+              (std::is_pointer<RandomAccessIterator>::value ||
+               std::is_same<RandomAccessIterator,
+                            typename std::vector<V>::iterator>::value ||
+               std::is_same<RandomAccessIterator,
+                            typename std::vector<V>::const_iterator>::value ||
+               std::is_same<RandomAccessIterator,
+                            std::string::iterator>::value ||
+               std::is_same<RandomAccessIterator,
+                            std::string::const_iterator>::value)> {};
+
+// the 1st occurrence of /pattern/ in /text/ as raw bytes, nullptr if none
+// candidates matching first and last bytes of /pattern/ are picked 16
+// positions at a time with SSE2, then verified with memcmp.
+inline const char* scan(const char* text, std::size_t n, const char* pattern,
+                        std::size_t m) {
+  if (0 == m || n < m) return nullptr;
+  if (1 == m) return static_cast<const char*>(std::memchr(text, *pattern, n));
+
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i head = _mm_set1_epi8(pattern[0]);
+  const __m128i tail = _mm_set1_epi8(pattern[m - 1]);
+  for (; i + m + 15 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail)));
+    for (; mask != 0; mask &= mask - 1) {
+      const char* candidate = text + i + __builtin_ctz(mask);
+      if (0 == std::memcmp(candidate + 1, pattern + 1, m - 2)) {
+        return candidate;
+      }
+    }
+  }
+#endif
+  const char* end = text + n - m + 1;  // candidates lie in [text, end)
+  for (const char* p = text + i; p < end; ++p) {
+    p = static_cast<const char*>(std::memchr(p, *pattern, end - p));
+    if (nullptr == p) return nullptr;
+    if (p[m - 1] == pattern[m - 1] &&
+        0 == std::memcmp(p + 1, pattern + 1, m - 2)) {
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Boyer-Moore search with good suffix and bad character rules
+template <typename RandomAccessIterator, typename Pattern>
+RandomAccessIterator boyer_moore_find(RandomAccessIterator first,
+                                      RandomAccessIterator last,
+                                      const Pattern& subseq) {
   if (first >= last) {
     return last;
   }
@@ -138,31 +324,265 @@ RandomAccessIterator find(RandomAccessIterator first, RandomAccessIterator last,
   return last;  // no match
 }
 
+template <typename RandomAccessIterator, typename Pattern>
+RandomAccessIterator find(RandomAccessIterator first, RandomAccessIterator last,
+                          const Pattern& subseq, std::false_type) {
+  return boyer_moore_find(first, last, subseq);
+}
+
+template <typename RandomAccessIterator, typename Pattern>
+RandomAccessIterator find(RandomAccessIterator first, RandomAccessIterator last,
+                          const Pattern& subseq, std::true_type) {
+  if (first >= last || 0 == subseq.size()) {
+    return last;
+  }
+  const char* text = reinterpret_cast<const char*>(&*first);
+  const char* found = scan(text, last - first,
+                           reinterpret_cast<const char*>(subseq.data()),
+                           subseq.size());
+  return nullptr == found ? last : first + (found - text);
+}
+
+// call report(iterator) for every occurrence of subseq in [first, last)
+template <typename RandomAccessIterator, typename Pattern, typename Function>
+Function for_each_match(RandomAccessIterator first, RandomAccessIterator last,
+                        const Pattern& subseq, Function report) {
+  for (first = find(first, last, subseq); first != last;
+       first = find(next(first, subseq), last, subseq)) {
+    report(first);
+  }
+  return report;
+}
+
+template <typename RandomAccessIterator, typename Pattern>
+std::size_t count(RandomAccessIterator first, RandomAccessIterator last,
+                  const Pattern& subseq) {
+  std::size_t counter = 0;
+  for_each_match(first, last, subseq,
+                 [&counter](RandomAccessIterator) { ++counter; });
+  return counter;
+}
+}  // namespace internal
+
+// find the 1st occurrence of subseq in sequence [first, last),
+//	return last if not found
+// remarks: contiguous byte sequences take a SIMD scan instead of Boyer-Moore
+template <typename RandomAccessIterator, typename T>
+RandomAccessIterator find(RandomAccessIterator first, RandomAccessIterator last,
+                          const Subsequence<T>& subseq) {
+  return internal::find(first, last, subseq,
+                        internal::is_byte_range<RandomAccessIterator, T>());
+}
+template <typename RandomAccessIterator, typename T, std::size_t N>
+RandomAccessIterator find(RandomAccessIterator first, RandomAccessIterator last,
+                          const FixedSubsequence<T, N>& subseq) {
+  return internal::find(first, last, subseq,
+                        internal::is_byte_range<RandomAccessIterator, T>());
+}
+
 // search subseq in sequence [first, last), return true if found
 template <typename RandomAccessIterator, typename T>
 bool search(RandomAccessIterator first, RandomAccessIterator last,
             const Subsequence<T>& subseq) {
   return find(first, last, subseq) != last;
 }
+template <typename RandomAccessIterator, typename T, std::size_t N>
+bool search(RandomAccessIterator first, RandomAccessIterator last,
+            const FixedSubsequence<T, N>& subseq) {
+  return find(first, last, subseq) != last;
+}
+
+// get next position to be searched
+// pre-condition: first donates a match of subseq
+template <typename RandomAccessIterator, typename T>
+RandomAccessIterator next(RandomAccessIterator first,
+                          const Subsequence<T>& subseq) {
+  return first + subseq.good_suffix(0) + 1 - subseq.size();
+}
+template <typename RandomAccessIterator, typename T, std::size_t N>
+RandomAccessIterator next(RandomAccessIterator first,
+                          const FixedSubsequence<T, N>& subseq) {
+  return first + subseq.good_suffix(0) + 1 - subseq.size();
+}
 
 // count occurrence of subseq in sequence [first, last)
 template <typename RandomAccessIterator, typename T>
 std::size_t count(RandomAccessIterator first, RandomAccessIterator last,
                   const Subsequence<T>& subseq) {
-  std::size_t counter = 0;
-  for (first = find(first, last, subseq); first != last;
-       first = find(next(first, subseq), last, subseq)) {
-    ++counter;
+  return internal::count(first, last, subseq);
+}
+template <typename RandomAccessIterator, typename T, std::size_t N>
+std::size_t count(RandomAccessIterator first, RandomAccessIterator last,
+                  const FixedSubsequence<T, N>& subseq) {
+  return internal::count(first, last, subseq);
+}
+
+// resumable searcher over a sequence fed in chunks, such as blocks read from
+// a stream. the last size() - 1 elements of input are carried to the next
+// chunk, so occurrences across chunk boundaries are found as well.
+// =============================================================================
+template <typename Pattern>
+class Scanner {
+ public:
+  typedef Pattern pattern_type;
+  typedef typename pattern_type::value_type value_type;
+  typedef std::size_t size_type;
+
+  enum { BLOCK_SIZE = 1 << 16 };  // elements read from a stream at once
+
+ public:
+  // pre-condition: /subseq/ outlives the scanner
+  explicit Scanner(const pattern_type& subseq) : subseq_(&subseq) {}
+
+  // feed the next chunk [first, last), call report(size_type position) for
+  // every occurrence ending in it, in order, with its start position counted
+  // from the beginning of input
+  template <typename RandomAccessIterator, typename Function>
+  Function scan(RandomAccessIterator first, RandomAccessIterator last,
+                Function report) {
+    feed(first, last, report);
+    return report;
+  }
+
+  // feed the rest of /stream/ in blocks of /block_size/ characters
+  template <typename Function>
+  Function scan(std::istream& stream, Function report,
+                size_type block_size = BLOCK_SIZE) {
+    static_assert(std::is_same<value_type, char>::value,
+                  "Scanner: streams need char subsequences");
+    std::vector<char> block(std::max<size_type>(block_size, 1));
+    while (stream.read(block.data(), block.size()) || stream.gcount() > 0) {
+      feed(block.data(), block.data() + stream.gcount(), report);
+    }
+    return report;
+  }
+
+  // restart as at the beginning of input
+  void reset() {
+    tail_.clear();
+    position_ = 0;
+  }
+
+  // number of elements fed
+  size_type position() const { return position_; }
+
+ private:
+  typedef std::vector<value_type> tail_type;
+
+  template <typename RandomAccessIterator, typename Function>
+  void feed(RandomAccessIterator first, RandomAccessIterator last,
+            Function& report) {
+    const size_type m = subseq_->size(), n = last - first;
+    if (0 == m) {
+      position_ += n;
+      return;
+    }
+
+    if (!tail_.empty()) {  // occurrences starting in the carried tail
+      const size_type carried = tail_.size(), offset = position_ - carried;
+      tail_.insert(tail_.end(), first, first + std::min(n, m - 1));
+      internal::for_each_match(
+          tail_.begin(), tail_.end(), *subseq_,
+          [this, &report, offset](typename tail_type::iterator iter) {
+            report(offset + (iter - tail_.begin()));
+          });
+      tail_.resize(carried);
+    }
+    internal::for_each_match(first, last, *subseq_,
+                             [this, &report, first](RandomAccessIterator iter) {
+                               report(position_ + (iter - first));
+                             });
+
+    if (n >= m - 1) {
+      tail_.assign(last - (m - 1), last);
+    } else {
+      tail_.insert(tail_.end(), first, last);
+      tail_.erase(tail_.begin(), tail_.end() - std::min(tail_.size(), m - 1));
+    }
+    position_ += n;
   }
+
+ private:
+  const pattern_type* subseq_;
+  tail_type tail_;
+  size_type position_ = 0;
+};
+
+namespace internal {
+enum { MIN_SEARCH_CHUNK = 1 << 16 };  // positions per thread at least
+
+// threads to search /n/ elements for subseq of /m/, /requested/ 0 means
+// hardware concurrency
+inline std::size_t search_thread_count(std::size_t n, std::size_t m,
+                                       std::size_t requested) {
+  std::size_t starts = 0 < m && m <= n ? n - m + 1 : 0;
+  return parallel::thread_count(
+      requested, std::max<std::size_t>(starts / MIN_SEARCH_CHUNK, 1));
+}
+
+// search [first, last) on /thread_count/ threads and call
+// report(iterator, chunk_index) for every occurrence, chunk i holds
+// occurrences before those of chunk i + 1.
+// pre-condition: thread_count is resolved by search_thread_count()
+template <typename RandomAccessIterator, typename Pattern, typename Function>
+void parallel_for_each_match(RandomAccessIterator first,
+                             RandomAccessIterator last, const Pattern& subseq,
+                             std::size_t thread_count, Function report) {
+  const std::size_t n = last - first, m = subseq.size();
+  if (0 == m || n < m) return;
+  parallel::for_each_range(
+      n - m + 1, thread_count,
+      [&](std::size_t begin, std::size_t end, std::size_t i) {
+        for_each_match(first + begin, first + (end + m - 1), subseq,
+                       [&report, i](RandomAccessIterator iter) {
+                         report(iter, i);
+                       });
+      });
+}
+}  // namespace internal
+
+// count occurrence of subseq in [first, last) on /thread_count/ threads,
+// 0 means hardware concurrency. memory-mapped files can be searched through
+// a pair of character pointers.
+// remarks: each thread takes a range of start positions and searches up to
+//  size() - 1 elements beyond it, so no occurrence is counted twice.
+template <typename RandomAccessIterator, typename Pattern>
+std::size_t parallel_count(RandomAccessIterator first,
+                           RandomAccessIterator last, const Pattern& subseq,
+                           std::size_t thread_count = 0) {
+  std::vector<std::size_t> counters(
+      internal::search_thread_count(last - first, subseq.size(), thread_count));
+  internal::parallel_for_each_match(
+      first, last, subseq, counters.size(),
+      [&counters](RandomAccessIterator, std::size_t i) { ++counters[i]; });
+  std::size_t counter = 0;
+  for (std::size_t i = 0; i < counters.size(); ++i) counter += counters[i];
   return counter;
 }
 
-// get next position to be searched
-// pre-condition: first donates a match of subseq
-template <typename RandomAccessIterator, typename T>
-RandomAccessIterator next(RandomAccessIterator first,
-                          const Subsequence<T>& subseq) {
-  return first + subseq.good_suffix(0) + 1 - subseq.size();
+// positions of every occurrence of subseq in [first, last) in order, counted
+// from /first/, searched on /thread_count/ threads like parallel_count()
+template <typename RandomAccessIterator, typename Pattern>
+std::vector<std::size_t> parallel_find_all(RandomAccessIterator first,
+                                           RandomAccessIterator last,
+                                           const Pattern& subseq,
+                                           std::size_t thread_count = 0) {
+  std::vector<std::vector<std::size_t> > chunks(
+      internal::search_thread_count(last - first, subseq.size(), thread_count));
+  internal::parallel_for_each_match(
+      first, last, subseq, chunks.size(),
+      [&chunks, first](RandomAccessIterator iter, std::size_t i) {
+        chunks[i].push_back(iter - first);
+      });
+
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < chunks.size(); ++i) total += chunks[i].size();
+  std::vector<std::size_t> positions;
+  positions.reserve(total);
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    positions.insert(positions.end(), chunks[i].begin(), chunks[i].end());
+  }
+  return positions;
 }
 
 // a convenient class for subsequence iteration in sequence
@@ -0,0 +1,103 @@
+// Compares bm::find against its Boyer-Moore path and std::search.
+// usage: bm_benchmark [text-file], an English-like text is generated if no
+// file is given.
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bm/bm.h"
+#include "timing/timing.h"
+
+namespace {
+
+std::size_t checksum = 0;  // keeps results alive
+
+// words drawn with Zipf-like frequencies, separated by spaces and periods
+std::string make_text(std::size_t size) {
+  const char* words[] = {
+      "the",     "of",       "and",      "to",       "in",     "is",
+      "that",    "for",      "it",       "as",       "was",    "with",
+      "be",      "by",       "on",       "not",      "he",     "this",
+      "are",     "or",       "his",      "from",     "at",     "which",
+      "but",     "have",     "an",       "had",      "they",   "you",
+      "were",    "their",    "one",      "all",      "we",     "can",
+      "her",     "has",      "there",    "been",     "if",     "more",
+      "when",    "will",     "would",    "who",      "so",     "no",
+      "search",  "pattern",  "algorithm", "sequence", "memory", "string",
+      "machine", "language", "number",   "function", "between", "through"};
+  const std::size_t n = sizeof(words) / sizeof(words[0]);
+  std::vector<double> weights(n);
+  for (std::size_t i = 0; i < n; ++i) weights[i] = 1.0 / (i + 1);
+  std::mt19937 rng(2024);
+  std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+
+  std::string text;
+  text.reserve(size + 16);
+  while (text.size() < size) {
+    text += words[pick(rng)];
+    text += (rng() % 12 == 0) ? ". " : " ";
+  }
+  text.resize(size);
+  return text;
+}
+
+template <typename Function>
+double throughput(const std::string& text, Function find) {
+  timing::Timer timer;
+  std::size_t rounds = 0;
+  timer.start();
+  do {
+    checksum += find(text.data(), text.data() + text.size()) - text.data();
+    ++rounds;
+  } while (timer.duration() < 0.5);
+  timer.stop();
+  return text.size() * rounds / timer.duration() / (1 << 20);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string text;
+  if (argc > 1) {
+    std::ifstream is(argv[1], std::ios::binary);
+    text.assign(std::istreambuf_iterator<char>(is),
+                std::istreambuf_iterator<char>());
+  } else {
+    text = make_text(64 << 20);
+  }
+  // absent from the generated text, so every search scans it all
+  const char* patterns[] = {
+      "zq", "language machinery",
+      "the number of the string between the function and the sequence zz"};
+
+  std::cout << "text: " << (text.size() >> 20) << " MB, MB/s" << std::endl;
+  std::cout << std::setw(8) << "length" << std::setw(14) << "bm::find"
+            << std::setw(14) << "boyer-moore" << std::setw(14)
+            << "std::search" << std::endl;
+  for (const char* p : patterns) {
+    std::string pattern(p);
+    bm::Subsequence<char> subseq(pattern.begin(), pattern.end());
+    double fast = throughput(text, [&](const char* first, const char* last) {
+      return bm::find(first, last, subseq);
+    });
+    double classic =
+        throughput(text, [&](const char* first, const char* last) {
+          return bm::internal::boyer_moore_find(first, last, subseq);
+        });
+    double standard =
+        throughput(text, [&](const char* first, const char* last) {
+          return std::search(first, last, pattern.begin(), pattern.end());
+        });
+    std::cout << std::fixed << std::setprecision(0) << std::setw(8)
+              << pattern.size() << std::setw(14) << fast << std::setw(14)
+              << classic << std::setw(14) << standard << std::endl;
+  }
+  std::cout << "checksum: " << checksum << std::endl;
+  return 0;
+}
@@ -1,7 +1,12 @@
 #include "bm/bm.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -45,3 +50,166 @@ TEST(BMTest, Bug1) {
   bm::Subsequence<char> subseq(s1.begin(), s1.end());
   EXPECT_EQ(bm::count(str.begin(), str.end(), subseq), 2);
 }
+
+TEST(BMTest, Bug2) {
+  // the good suffix table ignored matched suffixes which have a prefix of
+  // subseq as their suffix, so "aaa...a" skipped over a shorter realignment
+  std::string s1(14, 'a'), str("ab" + std::string(14, 'a'));
+  bm::Subsequence<char> subseq(s1.begin(), s1.end());
+  EXPECT_EQ(bm::internal::boyer_moore_find(str.begin(), str.end(), subseq) -
+                str.begin(),
+            2);
+}
+
+TEST(BMTest, ByteScanMatchesBoyerMoore) {
+  std::srand(3);
+  for (int round = 0; round < 200; ++round) {
+    std::string pattern(1 + std::rand() % 40, 'a');
+    for (auto& c : pattern) c = 'a' + std::rand() % 3;
+    std::string text(std::rand() % 300, 'a');
+    for (auto& c : text) c = 'a' + std::rand() % 3;
+    if (round % 4 == 0 && text.size() > pattern.size()) {
+      text.replace(text.size() - pattern.size(), pattern.size(), pattern);
+    }
+    bm::Subsequence<char> subseq(pattern.begin(), pattern.end());
+    std::size_t expected = text.find(pattern);
+    if (expected == std::string::npos) expected = text.size();
+
+    EXPECT_EQ(bm::find(text.begin(), text.end(), subseq) - text.begin(),
+              expected);
+    EXPECT_EQ(bm::find(text.data(), text.data() + text.size(), subseq) -
+                  text.data(),
+              expected);
+    EXPECT_EQ(bm::internal::boyer_moore_find(text.begin(), text.end(),
+                                             subseq) -
+                  text.begin(),
+              expected);
+  }
+}
+
+TEST(BMTest, BinaryPatternsMatchNaiveSearch) {
+  std::srand(7);
+  for (int round = 0; round < 500; ++round) {
+    std::vector<unsigned char> pattern(std::rand() % 12);
+    std::vector<unsigned char> text(std::rand() % 80);
+    for (auto& c : pattern) c = std::rand() % 2 ? 0 : 255;
+    for (auto& c : text) c = std::rand() % 2 ? 0 : 255;
+    bm::Subsequence<unsigned char> subseq(pattern.begin(), pattern.end());
+    std::size_t expected = 0;
+    for (auto first = text.begin();; ++first) {
+      first = std::search(first, text.end(), pattern.begin(), pattern.end());
+      if (first == text.end() || pattern.empty()) break;
+      ++expected;
+    }
+    EXPECT_EQ(bm::count(text.begin(), text.end(), subseq), expected);
+    EXPECT_EQ(bm::internal::count(text.begin(), text.end(), subseq),
+              expected);
+  }
+}
+
+TEST(BMTest, BoolSequence) {
+  // std::vector<bool> packs bits, it must not take the raw memory scan
+  std::vector<bool> pattern = {true, false, true};
+  std::vector<bool> text = {false, true, false, true, false, true, true};
+  bm::Subsequence<bool> subseq(pattern.begin(), pattern.end());
+  EXPECT_EQ(bm::find(text.begin(), text.end(), subseq) - text.begin(), 1);
+  EXPECT_EQ(bm::count(text.begin(), text.end(), subseq), 2);
+}
+
+TEST(BMTest, LongPattern) {
+  std::string pattern(4096, 'a'), text(1 << 16, 'a');
+  pattern[0] = 'b';
+  text[text.size() - pattern.size()] = 'b';
+  bm::Subsequence<char> subseq(pattern.begin(), pattern.end());
+  EXPECT_EQ(bm::find(text.begin(), text.end(), subseq) - text.begin(),
+            text.size() - pattern.size());
+}
+
+TEST(FixedSubsequenceTest, ItWorks) {
+  static constexpr auto needle = bm::make_subsequence("abcab");
+  static_assert(needle.size() == 5, "");
+  static_assert(needle.bad_character('a') == 1, "");
+  static_assert(needle.bad_character('z') == 5, "");
+  static_assert(needle.good_suffix(4) == 1, "");
+  static_assert(needle.good_suffix(0) == 7, "");
+
+  std::string str("abcabcabxabcab");
+  EXPECT_EQ(bm::find(str.begin(), str.end(), needle) - str.begin(), 0);
+  EXPECT_EQ(bm::count(str.begin(), str.end(), needle), 3);
+  EXPECT_EQ(bm::internal::count(str.begin(), str.end(), needle), 3);
+  EXPECT_TRUE(bm::search(str.begin(), str.end(), needle));
+  bm::Subsequence<char> subseq(needle.begin(), needle.end());
+  for (std::size_t i = 0; i < needle.size(); ++i) {
+    EXPECT_EQ(needle.good_suffix(i), subseq.good_suffix(i));
+  }
+}
+
+namespace {
+std::vector<std::size_t> find_all(const std::string& str,
+                                  const std::string& s1) {
+  std::vector<std::size_t> positions;
+  for (std::size_t i = str.find(s1); i != std::string::npos;
+       i = str.find(s1, i + 1)) {
+    positions.push_back(i);
+  }
+  return positions;
+}
+
+std::string random_text(std::size_t n, int alphabet) {
+  std::string str(n, 'a');
+  for (auto& c : str) c = 'a' + std::rand() % alphabet;
+  return str;
+}
+}  // namespace
+
+TEST(ScannerTest, ChunksMatchWholeText) {
+  std::srand(11);
+  for (int round = 0; round < 200; ++round) {
+    std::string s1 = random_text(1 + std::rand() % 8, 2);
+    std::string str = random_text(std::rand() % 200, 2);
+    bm::Subsequence<char> subseq(s1.begin(), s1.end());
+    bm::Scanner<bm::Subsequence<char> > scanner(subseq);
+    std::vector<std::size_t> actual;
+    for (std::size_t i = 0; i < str.size();) {
+      std::size_t n = std::min<std::size_t>(std::rand() % 10, str.size() - i);
+      scanner.scan(str.begin() + i, str.begin() + i + n,
+                   [&actual](std::size_t pos) { actual.push_back(pos); });
+      i += n;
+    }
+    EXPECT_EQ(scanner.position(), str.size());
+    EXPECT_EQ(actual, find_all(str, s1)) << s1 << " in " << str;
+  }
+}
+
+TEST(ScannerTest, Stream) {
+  std::srand(13);
+  std::string str = random_text(100000, 3);
+  static constexpr auto needle = bm::make_subsequence("abcab");
+  bm::Scanner<decltype(needle)> scanner(needle);
+  std::istringstream stream(str);
+  std::vector<std::size_t> actual;
+  scanner.scan(stream, [&actual](std::size_t pos) { actual.push_back(pos); },
+               1000);
+  EXPECT_EQ(actual, find_all(str, "abcab"));
+
+  scanner.reset();
+  EXPECT_EQ(scanner.position(), 0);
+}
+
+TEST(ParallelTest, MatchesSequentialSearch) {
+  std::srand(17);
+  std::string str = random_text(1 << 19, 2);
+  for (const char* s1 : {"a", "abba", "abbbbbbbbbbabaaaab"}) {
+    bm::Subsequence<char> subseq(s1, s1 + std::strlen(s1));
+    std::vector<std::size_t> expected = find_all(str, s1);
+    for (std::size_t threads : {1, 3, 8}) {
+      EXPECT_EQ(bm::parallel_find_all(str.begin(), str.end(), subseq, threads),
+                expected);
+      EXPECT_EQ(bm::parallel_count(str.data(), str.data() + str.size(),
+                                   subseq, threads),
+                expected.size());
+    }
+  }
+  bm::Subsequence<char> subseq(str.begin(), str.end());
+  EXPECT_EQ(bm::parallel_count(str.begin(), str.begin() + 10, subseq), 0);
+}
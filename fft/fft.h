@@ -2,104 +2,875 @@
 #ifndef FFT_H_
 #define FFT_H_
 
+#include <algorithm>
 #include <cmath>
 #include <complex>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
+#include "parallel/parallel.h"
+
 namespace fft {
 
-// class Filter: establish fft machine
+namespace internal {
+
+// lengths whose prime factors all stay within this bound are decomposed into
+// mixed radix butterflies, other lengths go through Bluestein's chirp-z
+enum { MAX_GENERIC_RADIX = 31 };
+
+// transforms shorter than this are never split across threads
+enum { MIN_PARALLEL_SIZE = 1 << 14 };
+
+// class Plan: complex transform of an arbitrary fixed length
+// remarks: decimation in time over the factors 4, 2, 3, 5 and then any other
+//  small prime; a plan is immutable after establish(), so execute() can run
+//  concurrently on shared plans.
 template <typename FloatT>
-class Filter {
+class Plan {
  public:
   typedef FloatT float_type;
   typedef std::size_t size_type;
   typedef std::complex<float_type> value_type;
 
  public:
-  void establish(size_type seq_len) {
-    // get minimum 2 power not less than seq_len
-    size_type len_pow2 = 2, pow = 1;
-    for (; len_pow2 < seq_len && len_pow2 != 0; len_pow2 <<= 1, ++pow) {
+  Plan() : size_(0) {}
+
+  void establish(size_type len) {
+    size_ = len;
+    factors_.clear();
+    twiddles_.clear();
+    inverse_twiddles_.clear();
+    chirp_.clear();
+    chirp_spectrum_.clear();
+    conv_plan_.reset();
+    if (len <= 1) return;
+
+    // factorize len: 4 first, then 2, 3, 5, 7, ...
+    // factors_ holds pairs of (radix, remaining length)
+    bool smooth = true;
+    size_type remain = len, radix = 4;
+    while (remain > 1) {
+      while (remain % radix != 0) {
+        switch (radix) {
+          case 4:
+            radix = 2;
+            break;
+          case 2:
+            radix = 3;
+            break;
+          default:
+            radix += 2;
+            break;
+        }
+        if (radix * radix > remain) radix = remain;  // remain is prime
+      }
+      if (radix > MAX_GENERIC_RADIX) {
+        smooth = false;
+        break;
+      }
+      remain /= radix;
+      factors_.push_back(radix);
+      factors_.push_back(remain);
+    }
+
+    if (smooth) {
+      twiddles_.resize(len);
+      inverse_twiddles_.resize(len);
+      for (size_type i = 0; i < len; ++i) {
+        twiddles_[i] = unit_root(i, len);
+        inverse_twiddles_[i] = std::conj(twiddles_[i]);
+      }
+    } else {
+      factors_.clear();
+      establish_bluestein();
     }
-    if (0 == len_pow2) {
-      throw std::runtime_error(
-          "Filter::establish(size_type): seq_len too large");
+  }
+
+  size_type size() const { return size_; }
+
+  // whether Bluestein's algorithm is used for this length
+  bool bluestein() const { return conv_plan_ != nullptr; }
+
+  // transform [in, in + size() * in_stride) with step in_stride into
+  // [out, out + size()), unscaled in both directions.
+  // thread_count: threads sharing the sub-transforms and butterflies of the
+  //  outer stages, 0 for hardware concurrency
+  // pre-condition: input and output do not overlap
+  void execute(const value_type* in, size_type in_stride, value_type* out,
+               bool inverse, size_type thread_count = 1) const {
+    thread_count = parallel::thread_count(thread_count, size_);
+    if (size_ <= 1) {
+      if (size_ == 1) out[0] = in[0];
+    } else if (bluestein()) {
+      execute_bluestein(in, in_stride, out, inverse, thread_count);
+    } else if (thread_count > 1 && size_ >= MIN_PARALLEL_SIZE) {
+      work_parallel(out, in, 1, in_stride, factors_.data(),
+                    inverse ? inverse_twiddles_.data() : twiddles_.data(),
+                    inverse, thread_count);
+    } else {
+      work(out, in, 1, in_stride, factors_.data(),
+           inverse ? inverse_twiddles_.data() : twiddles_.data(), inverse);
     }
+  }
 
-    // create omega used in fft (half is enough)
-    float_type pi = acos((float_type)(-1));
-    float_type delta = -2 * pi / len_pow2;
-    omega_.resize(len_pow2 >> 1);  // half size is enough
-    for (size_type i = 0; i < omega_.size(); ++i)
-      omega_[i] = value_type(cos(i * delta), sin(i * delta));
-
-    // re-order indices of sequence
-    index_.assign(len_pow2, 0);
-    for (size_type i = 0; i < pow; ++i) {
-      size_type add = 1 << i;
-      size_type check =
-          1 << (pow - 1 - i);  // 2^(pow-1-i) == (len_pow2/2)*(1/2)^i
-      for (size_type j = 0; j < len_pow2; ++j) {
-        if ((j / check) & 0x01)  // odd number
-          index_[j] += add;
+ private:
+  // exp(-2*pi*i*k/n)
+  static value_type unit_root(size_type k, size_type n) {
+    long double phase = -2 * acosl(-1) * k / n;
+    return value_type(float_type(cosl(phase)), float_type(sinl(phase)));
+  }
+
+  static value_type mul(const value_type& a, const value_type& b) {
+    return value_type(a.real() * b.real() - a.imag() * b.imag(),
+                      a.real() * b.imag() + a.imag() * b.real());
+  }
+
+  // recursive decimation in time
+  void work(value_type* out, const value_type* in, size_type fstride,
+            size_type in_stride, const size_type* factors,
+            const value_type* tw, bool inverse) const {
+    size_type radix = factors[0], sub_len = factors[1];
+    value_type* out_end = out + radix * sub_len;
+    if (sub_len == 1) {
+      for (value_type* pos = out; pos != out_end; ++pos) {
+        *pos = *in;
+        in += fstride * in_stride;
+      }
+    } else {
+      for (value_type* pos = out; pos != out_end; pos += sub_len) {
+        work(pos, in, fstride * radix, in_stride, factors + 2, tw, inverse);
+        in += fstride * in_stride;
+      }
+    }
+
+    butterfly(out, fstride, tw, radix, sub_len, 0, sub_len, inverse);
+  }
+
+  // same as work(), sub-transforms and butterflies of the outer stages are
+  // split across thread_count threads
+  void work_parallel(value_type* out, const value_type* in, size_type fstride,
+                     size_type in_stride, const size_type* factors,
+                     const value_type* tw, bool inverse,
+                     size_type thread_count) const {
+    size_type radix = factors[0], sub_len = factors[1];
+    if (sub_len == 1 || thread_count <= 1) {
+      work(out, in, fstride, in_stride, factors, tw, inverse);
+      return;
+    }
+
+    size_type sub_threads = thread_count / radix;
+    parallel::for_each_range(
+        radix, thread_count,
+        [&](size_type begin, size_type end, size_type) {
+          for (size_type i = begin; i < end; ++i) {
+            work_parallel(out + i * sub_len, in + i * fstride * in_stride,
+                          fstride * radix, in_stride, factors + 2, tw, inverse,
+                          sub_threads);
+          }
+        });
+    parallel::for_each_range(
+        sub_len, thread_count,
+        [&](size_type begin, size_type end, size_type) {
+          butterfly(out, fstride, tw, radix, sub_len, begin, end, inverse);
+        });
+  }
+
+  // radix butterflies of positions [begin, end) within [0, m)
+  void butterfly(value_type* out, size_type fstride, const value_type* tw,
+                 size_type radix, size_type m, size_type begin, size_type end,
+                 bool inverse) const {
+    switch (radix) {
+      case 2:
+        butterfly2(out, fstride, tw, m, begin, end);
+        break;
+      case 3:
+        butterfly3(out, fstride, tw, m, begin, end);
+        break;
+      case 4:
+        butterfly4(out, fstride, tw, m, begin, end, inverse);
+        break;
+      case 5:
+        butterfly5(out, fstride, tw, m, begin, end);
+        break;
+      default:
+        butterfly_generic(out, fstride, tw, m, begin, end, radix);
+        break;
+    }
+  }
+
+  static void butterfly2(value_type* out, size_type fstride,
+                         const value_type* tw, size_type m, size_type begin,
+                         size_type end) {
+    value_type* out2 = out + m;
+    tw += begin * fstride;
+    for (size_type k = begin; k < end; ++k, tw += fstride) {
+      value_type t = mul(out2[k], *tw);
+      out2[k] = out[k] - t;
+      out[k] += t;
+    }
+  }
+
+  static void butterfly3(value_type* out, size_type fstride,
+                         const value_type* tw, size_type m, size_type begin,
+                         size_type end) {
+    float_type epi3 = tw[fstride * m].imag();
+    const value_type *tw1 = tw + begin * fstride, *tw2 = tw1 + begin * fstride;
+    out += begin;
+    for (size_type k = begin; k < end; ++k, ++out) {
+      value_type s1 = mul(out[m], *tw1), s2 = mul(out[2 * m], *tw2);
+      value_type s3 = s1 + s2, s0 = (s1 - s2) * epi3;
+      tw1 += fstride;
+      tw2 += fstride * 2;
+      value_type half = out[0] - s3 * float_type(0.5);
+      out[0] += s3;
+      out[2 * m] = value_type(half.real() + s0.imag(), half.imag() - s0.real());
+      out[m] = value_type(half.real() - s0.imag(), half.imag() + s0.real());
+    }
+  }
+
+  static void butterfly4(value_type* out, size_type fstride,
+                         const value_type* tw, size_type m, size_type begin,
+                         size_type end, bool inverse) {
+    const value_type* tw1 = tw + begin * fstride;
+    const value_type* tw2 = tw1 + begin * fstride;
+    const value_type* tw3 = tw2 + begin * fstride;
+    out += begin;
+    for (size_type k = begin; k < end; ++k, ++out) {
+      value_type s0 = mul(out[m], *tw1);
+      value_type s1 = mul(out[2 * m], *tw2);
+      value_type s2 = mul(out[3 * m], *tw3);
+      value_type s5 = out[0] - s1;
+      out[0] += s1;
+      value_type s3 = s0 + s2, s4 = s0 - s2;
+      out[2 * m] = out[0] - s3;
+      out[0] += s3;
+      tw1 += fstride;
+      tw2 += fstride * 2;
+      tw3 += fstride * 3;
+      if (inverse) {
+        out[m] = value_type(s5.real() - s4.imag(), s5.imag() + s4.real());
+        out[3 * m] = value_type(s5.real() + s4.imag(), s5.imag() - s4.real());
+      } else {
+        out[m] = value_type(s5.real() + s4.imag(), s5.imag() - s4.real());
+        out[3 * m] = value_type(s5.real() - s4.imag(), s5.imag() + s4.real());
       }
     }
   }
 
-  size_type point_count() const { return omega_.size() << 1; }
+  static void butterfly5(value_type* out, size_type fstride,
+                         const value_type* tw, size_type m, size_type begin,
+                         size_type end) {
+    value_type ya = tw[fstride * m], yb = tw[fstride * 2 * m];
+    value_type *out0 = out, *out1 = out + m, *out2 = out + 2 * m,
+               *out3 = out + 3 * m, *out4 = out + 4 * m;
+    for (size_type u = begin; u < end; ++u) {
+      value_type s0 = out0[u];
+      value_type s1 = mul(out1[u], tw[u * fstride]);
+      value_type s2 = mul(out2[u], tw[2 * u * fstride]);
+      value_type s3 = mul(out3[u], tw[3 * u * fstride]);
+      value_type s4 = mul(out4[u], tw[4 * u * fstride]);
+      value_type s7 = s1 + s4, s10 = s1 - s4, s8 = s2 + s3, s9 = s2 - s3;
+      out0[u] += s7 + s8;
+
+      value_type s5(s0.real() + s7.real() * ya.real() + s8.real() * yb.real(),
+                    s0.imag() + s7.imag() * ya.real() + s8.imag() * yb.real());
+      value_type s6(s10.imag() * ya.imag() + s9.imag() * yb.imag(),
+                    -s10.real() * ya.imag() - s9.real() * yb.imag());
+      out1[u] = s5 - s6;
+      out4[u] = s5 + s6;
+
+      value_type s11(s0.real() + s7.real() * yb.real() + s8.real() * ya.real(),
+                     s0.imag() + s7.imag() * yb.real() + s8.imag() * ya.real());
+      value_type s12(-s10.imag() * yb.imag() + s9.imag() * ya.imag(),
+                     s10.real() * yb.imag() - s9.real() * ya.imag());
+      out2[u] = s11 + s12;
+      out3[u] = s11 - s12;
+    }
+  }
+
+  void butterfly_generic(value_type* out, size_type fstride,
+                         const value_type* tw, size_type m, size_type begin,
+                         size_type end, size_type radix) const {
+    std::vector<value_type> scratch(radix);
+    for (size_type u = begin; u < end; ++u) {
+      for (size_type q = 0, k = u; q < radix; ++q, k += m) {
+        scratch[q] = out[k];
+      }
+      for (size_type q = 0, k = u; q < radix; ++q, k += m) {
+        size_type twidx = 0;
+        out[k] = scratch[0];
+        for (size_type j = 1; j < radix; ++j) {
+          twidx += fstride * k;
+          if (twidx >= size_) twidx -= size_;
+          out[k] += mul(scratch[j], tw[twidx]);
+        }
+      }
+    }
+  }
+
+  // Bluestein: X[k] = c[k] * sum(x[n] * c[n] * conj(c[k-n])), where
+  //  c[n] = exp(-pi*i*n*n/size()), the sum is a cyclic convolution of
+  //  length conv_plan_->size() >= 2*size()-1 performed by power of 2 fft.
+  void establish_bluestein() {
+    size_type conv_len = 1;
+    while (conv_len < 2 * size_ - 1) conv_len <<= 1;
+    std::shared_ptr<Plan> conv_plan(new Plan());
+    conv_plan->establish(conv_len);
+
+    chirp_.resize(size_);
+    for (size_type i = 0; i < size_; ++i) {
+      // i*i mod 2*size() keeps phase accurate for large i
+      unsigned long long sq = (unsigned long long)i * i % (2 * size_);
+      chirp_[i] = unit_root(sq, 2 * size_);
+    }
+
+    std::vector<value_type> kernel(conv_len);
+    kernel[0] = std::conj(chirp_[0]);
+    for (size_type i = 1; i < size_; ++i) {
+      kernel[i] = kernel[conv_len - i] = std::conj(chirp_[i]);
+    }
+    chirp_spectrum_.resize(conv_len);
+    conv_plan->execute(kernel.data(), 1, chirp_spectrum_.data(), false);
+    float_type scale = float_type(1) / conv_len;
+    for (size_type i = 0; i < conv_len; ++i) chirp_spectrum_[i] *= scale;
+    conv_plan_ = conv_plan;
+  }
+
+  void execute_bluestein(const value_type* in, size_type in_stride,
+                         value_type* out, bool inverse,
+                         size_type thread_count) const {
+    // inverse(x) == conj(forward(conj(x)))
+    size_type conv_len = conv_plan_->size();
+    std::vector<value_type> work(conv_len), spectrum(conv_len);
+    for (size_type i = 0; i < size_; ++i, in += in_stride) {
+      work[i] = mul(inverse ? std::conj(*in) : *in, chirp_[i]);
+    }
+    conv_plan_->execute(work.data(), 1, spectrum.data(), false, thread_count);
+    for (size_type i = 0; i < conv_len; ++i) {
+      spectrum[i] = mul(spectrum[i], chirp_spectrum_[i]);
+    }
+    conv_plan_->execute(spectrum.data(), 1, work.data(), true, thread_count);
+    for (size_type i = 0; i < size_; ++i) {
+      out[i] = mul(work[i], chirp_[i]);
+      if (inverse) out[i] = std::conj(out[i]);
+    }
+  }
+
+ private:
+  size_type size_;
+  std::vector<size_type> factors_;
+  std::vector<value_type> twiddles_;
+  std::vector<value_type> inverse_twiddles_;
+
+  // Bluestein data, conv_plan_ is shared between copies of the plan
+  std::vector<value_type> chirp_;
+  std::vector<value_type> chirp_spectrum_;  // scaled by 1/conv_len
+  std::shared_ptr<const Plan> conv_plan_;
+};
+
+}  // namespace internal
+
+// class Filter: establish fft machine
+// remarks: transforms of any length are exact, smooth lengths use mixed radix
+//  butterflies and lengths with a large prime factor use Bluestein's algorithm.
+//  a filter is immutable after establish(), it can be shared read-only by
+//  threads transforming different sequences.
+template <typename FloatT>
+class Filter {
+ public:
+  typedef FloatT float_type;
+  typedef std::size_t size_type;
+  typedef std::complex<float_type> value_type;
+
+ public:
+  void establish(size_type seq_len) {
+    if (0 == seq_len) seq_len = 1;
+    plan_.establish(seq_len);
+
+    // real transform of even length goes through a half length plan
+    size_type half = seq_len >> 1;
+    half_plan_.establish(0 == (seq_len & 0x01) ? half : 0);
+
+    // create omega used to split half length result (half is enough)
+    long double delta = -2 * acosl(-1) / seq_len;
+    omega_.resize(half);
+    for (size_type i = 0; i < omega_.size(); ++i)
+      omega_[i] = value_type(float_type(cosl(i * delta)),
+                             float_type(sinl(i * delta)));
+  }
+
+  size_type point_count() const { return plan_.size(); }
 
   // RandomAccessContainer can be vector or deque
+  // thread_count: threads sharing one large transform, 0 for hardware
+  //  concurrency
   template <template <class T, class A = std::allocator<T> >
             class RandomAccessContainer>
   RandomAccessContainer<value_type>& filter(
+      RandomAccessContainer<value_type>& seq,
+      size_type thread_count = 1) const {
+    return transform(seq, false, thread_count);
+  }
+
+  template <template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer>
+  RandomAccessContainer<value_type>& operator()(
       RandomAccessContainer<value_type>& seq) const {
+    return filter(seq);
+  }
+
+  // inverse transform, scaled by 1/point_count() so that
+  // inverse(filter(seq)) restores seq
+  template <template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer>
+  RandomAccessContainer<value_type>& inverse(
+      RandomAccessContainer<value_type>& seq,
+      size_type thread_count = 1) const {
+    transform(seq, true, thread_count);
+    float_type scale = float_type(1) / point_count();
+    for (size_type i = 0; i < seq.size(); ++i) seq[i] *= scale;
+    return seq;
+  }
+
+  // real input transform: seq holds real samples (zero padded to
+  // point_count()), spectrum receives the packed non-redundant half
+  // X[0], X[1], ..., X[point_count()/2] (point_count()/2+1 values).
+  // remarks: for even point_count(), samples are packed pairwise into a half
+  //  length complex sequence, which is transformed and then split into the
+  //  full length spectrum.
+  template <template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer1,
+            template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer2>
+  RandomAccessContainer2<value_type>& filter_real(
+      const RandomAccessContainer1<float_type>& seq,
+      RandomAccessContainer2<value_type>& spectrum) const {
+    std::vector<value_type> input, work;
+    spectrum.resize((point_count() >> 1) + 1);
+    forward_real(seq, seq.size(), spectrum, input, work);
+    return spectrum;
+  }
+
+  // inverse of filter_real: spectrum holds X[0], ..., X[point_count()/2],
+  // seq receives point_count() real samples.
+  template <template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer1,
+            template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer2>
+  RandomAccessContainer2<float_type>& inverse_real(
+      const RandomAccessContainer1<value_type>& spectrum,
+      RandomAccessContainer2<float_type>& seq) const {
+    if (spectrum.size() < (point_count() >> 1) + 1) {
+      throw std::invalid_argument(
+          "Filter::inverse_real(spectrum, seq): spectrum too short");
+    }
+    std::vector<value_type> input, work;
+    seq.resize(point_count());
+    backward_real(spectrum, seq, input, work);
+    return seq;
+  }
+
+  // batch transform of count sequences in place, the i-th sequence occupies
+  // [data + i * stride, data + i * stride + point_count())
+  // thread_count: threads sharing the batch, 0 for hardware concurrency
+  // pre-condition: stride >= point_count()
+  void filter_batch(value_type* data, size_type stride, size_type count,
+                    size_type thread_count = 1) const {
+    transform_batch(data, stride, count, false, thread_count);
+  }
+
+  // batch inverse transform, scaled by 1/point_count()
+  void inverse_batch(value_type* data, size_type stride, size_type count,
+                     size_type thread_count = 1) const {
+    transform_batch(data, stride, count, true, thread_count);
+  }
+
+  // batch real input transform, the i-th sequence is read from
+  // [in + i * in_stride, in + i * in_stride + point_count()), its spectrum is
+  // written to [out + i * out_stride, out + i * out_stride + point_count()/2+1)
+  void filter_real_batch(const float_type* in, size_type in_stride,
+                         value_type* out, size_type out_stride,
+                         size_type count, size_type thread_count = 1) const {
+    parallel::for_each_range(
+        count, thread_count, [&](size_type begin, size_type end, size_type) {
+          std::vector<value_type> input, work;
+          for (size_type i = begin; i < end; ++i) {
+            const float_type* seq = in + i * in_stride;
+            value_type* spectrum = out + i * out_stride;
+            forward_real(seq, point_count(), spectrum, input, work);
+          }
+        });
+  }
+
+  // batch inverse of filter_real_batch, the i-th spectrum is read from
+  // [in + i * in_stride, in + i * in_stride + point_count()/2+1), its samples
+  // are written to [out + i * out_stride, out + i * out_stride + point_count())
+  void inverse_real_batch(const value_type* in, size_type in_stride,
+                          float_type* out, size_type out_stride,
+                          size_type count, size_type thread_count = 1) const {
+    parallel::for_each_range(
+        count, thread_count, [&](size_type begin, size_type end, size_type) {
+          std::vector<value_type> input, work;
+          for (size_type i = begin; i < end; ++i) {
+            const value_type* spectrum = in + i * in_stride;
+            float_type* seq = out + i * out_stride;
+            backward_real(spectrum, seq, input, work);
+          }
+        });
+  }
+
+ private:
+  template <template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer>
+  RandomAccessContainer<value_type>& transform(
+      RandomAccessContainer<value_type>& seq, bool inverse,
+      size_type thread_count) const {
+    size_type len = point_count();
+    seq.resize(len);  // fill extra zeros to point count
+
+    std::vector<value_type> input(seq.begin(), seq.end()), output(len);
+    plan_.execute(input.data(), 1, output.data(), inverse, thread_count);
+    for (size_type i = 0; i < len; ++i) seq[i] = output[i];
+    return seq;
+  }
+
+  void transform_batch(value_type* data, size_type stride, size_type count,
+                       bool inverse, size_type thread_count) const {
     size_type len = point_count();
-    seq.resize(len);  // fill extra zeros to base 2 sequence
-
-    // butterfly operation
-    RandomAccessContainer<value_type> work(len);
-    for (size_type i = 0; i < len; ++i) work[i] = seq[index_[i]];
-    for (size_type group_dist = 2; group_dist <= len;
-         group_dist <<= 1) {  // group distance
-      size_type group_count =
-          len / group_dist;  // butterfly count of current circle
-      size_type half_dist = group_dist >> 1;
-      for (size_type group_index = 0; group_index < group_count;
-           ++group_index) {  // for each group
-        size_type base_index = group_index * group_dist;
-        for (size_type i = 0; i < half_dist;
-             ++i)  // right half sequence multiplied by omega
-          work[base_index + half_dist + i] *= omega_[group_count * i];
-        for (size_type i = 0; i < half_dist;
-             ++i)  // left half result: seq[k]=work[k]+work[k+len/2]
-          seq[base_index + i] =
-              work[base_index + i] + work[base_index + half_dist + i];
-        for (size_type i = half_dist; i < group_dist;
-             ++i)  // right half result: seq[k+len/2]=work[k]-work[k+len/2]
-          seq[base_index + i] =
-              work[base_index - half_dist + i] - work[base_index + i];
+    float_type scale = float_type(1) / len;
+    parallel::for_each_range(
+        count, thread_count, [&](size_type begin, size_type end, size_type) {
+          std::vector<value_type> output(len);
+          for (size_type i = begin; i < end; ++i) {
+            value_type* seq = data + i * stride;
+            plan_.execute(seq, 1, output.data(), inverse);
+            if (inverse) {
+              for (size_type k = 0; k < len; ++k) seq[k] = output[k] * scale;
+            } else {
+              std::copy(output.begin(), output.end(), seq);
+            }
+          }
+        });
+  }
+
+  // seq[0, seq_len) zero padded to point_count() -> spectrum[0, half + 1)
+  // input, work: scratch buffers reused between calls
+  template <typename InputSequence, typename OutputSequence>
+  void forward_real(const InputSequence& seq, size_type seq_len,
+                    OutputSequence& spectrum, std::vector<value_type>& input,
+                    std::vector<value_type>& work) const {
+    size_type len = point_count(), half = len >> 1;
+    if (len & 0x01) {  // odd length, go through complex transform
+      input.assign(len, value_type());
+      work.resize(len);
+      for (size_type i = 0; i < len && i < seq_len; ++i) input[i] = seq[i];
+      plan_.execute(input.data(), 1, work.data(), false);
+      for (size_type k = 0; k <= half; ++k) spectrum[k] = work[k];
+      return;
+    }
+
+    input.resize(half);
+    work.resize(half);
+    for (size_type i = 0; i < half; ++i) {
+      size_type pos = i << 1;
+      float_type re = pos < seq_len ? seq[pos] : float_type(0);
+      float_type im = pos + 1 < seq_len ? seq[pos + 1] : float_type(0);
+      input[i] = value_type(re, im);
+    }
+    half_plan_.execute(input.data(), 1, work.data(), false);
+
+    // split: X[k] = E[k] + omega^k * O[k], where
+    //  E[k] = (Z[k] + conj(Z[half-k])) / 2
+    //  O[k] = -i * (Z[k] - conj(Z[half-k])) / 2
+    spectrum[0] = value_type(work[0].real() + work[0].imag());
+    spectrum[half] = value_type(work[0].real() - work[0].imag());
+    for (size_type k = 1; k < half; ++k) {
+      value_type zk = work[k], zc = std::conj(work[half - k]);
+      value_type even = (zk + zc) * float_type(0.5);
+      value_type odd = (zk - zc) * value_type(0, float_type(-0.5));
+      spectrum[k] = even + omega_[k] * odd;
+    }
+  }
+
+  // spectrum[0, half + 1) -> seq[0, point_count())
+  // input, work: scratch buffers reused between calls
+  template <typename InputSequence, typename OutputSequence>
+  void backward_real(const InputSequence& spectrum, OutputSequence& seq,
+                     std::vector<value_type>& input,
+                     std::vector<value_type>& work) const {
+    size_type len = point_count(), half = len >> 1;
+    if (len & 0x01) {  // odd length, restore hermitian symmetric spectrum
+      input.resize(len);
+      work.resize(len);
+      for (size_type k = 0; k <= half; ++k) input[k] = spectrum[k];
+      for (size_type k = half + 1; k < len; ++k)
+        input[k] = std::conj(spectrum[len - k]);
+      plan_.execute(input.data(), 1, work.data(), true);
+      float_type scale = float_type(1) / len;
+      for (size_type i = 0; i < len; ++i) seq[i] = work[i].real() * scale;
+      return;
+    }
+
+    // merge: Z[k] = E[k] + i * O[k], where
+    //  E[k] = (X[k] + conj(X[half-k])) / 2
+    //  O[k] = (X[k] - conj(X[half-k])) / 2 * conj(omega^k)
+    input.resize(half);
+    work.resize(half);
+    for (size_type k = 0; k < half; ++k) {
+      value_type xk = spectrum[k], xc = std::conj(spectrum[half - k]);
+      value_type even = (xk + xc) * float_type(0.5);
+      value_type odd = (xk - xc) * float_type(0.5) * std::conj(omega_[k]);
+      input[k] = even + value_type(0, 1) * odd;
+    }
+    half_plan_.execute(input.data(), 1, work.data(), true);
+
+    float_type scale = float_type(1) / half;
+    for (size_type i = 0; i < half; ++i) {
+      seq[i << 1] = work[i].real() * scale;
+      seq[(i << 1) + 1] = work[i].imag() * scale;
+    }
+  }
+
+ private:
+  internal::Plan<float_type> plan_;
+  internal::Plan<float_type> half_plan_;
+  std::vector<value_type> omega_;
+};
+
+// class ModularFilter: number theoretic transform modulo prime Modulus
+// remarks: Root generates the multiplicative group of Modulus; lengths are
+//  powers of 2 dividing Modulus - 1, results are exact residues.
+template <std::uint32_t Modulus, std::uint32_t Root>
+class ModularFilter {
+ public:
+  typedef std::uint32_t value_type;
+  typedef std::size_t size_type;
+
+ public:
+  // longest supported transform: highest power of 2 dividing Modulus - 1
+  static size_type max_point_count() {
+    size_type len = 1;
+    while ((Modulus - 1) % (len << 1) == 0) len <<= 1;
+    return len;
+  }
+
+  void establish(size_type seq_len) {
+    size_type len = 1;
+    while (len < seq_len) len <<= 1;
+    if (len > max_point_count()) {
+      throw std::length_error(
+          "ModularFilter::establish(size_type): seq_len too large");
+    }
+
+    // roots_[half + i] == w^i, w: primitive (2 * half)-th root of unity
+    roots_.assign(len, 1);
+    inverse_roots_.assign(len, 1);
+    for (size_type half = 1; half < len; half <<= 1) {
+      value_type w = power(Root, (Modulus - 1) / (half << 1));
+      value_type iw = power(w, Modulus - 2);
+      for (size_type i = 1; i < half; ++i) {
+        roots_[half + i] = mul(roots_[half + i - 1], w);
+        inverse_roots_[half + i] = mul(inverse_roots_[half + i - 1], iw);
       }
-      if (group_dist < len)
-        work.swap(seq);  // refill work vector for next circle
     }
+    inverse_len_ = power(value_type(len % Modulus), Modulus - 2);
+  }
 
+  size_type point_count() const { return roots_.size(); }
+
+  // RandomAccessContainer can be vector or deque, values in [0, Modulus)
+  template <template <class T, class A = std::allocator<T> >
+            class RandomAccessContainer>
+  RandomAccessContainer<value_type>& filter(
+      RandomAccessContainer<value_type>& seq) const {
+    seq.resize(point_count());
+    std::vector<value_type> work(seq.begin(), seq.end());
+    transform(work.data(), roots_);
+    std::copy(work.begin(), work.end(), seq.begin());
     return seq;
   }
 
+  // inverse transform, scaled by 1/point_count()
   template <template <class T, class A = std::allocator<T> >
             class RandomAccessContainer>
-  RandomAccessContainer<value_type>& operator()(
+  RandomAccessContainer<value_type>& inverse(
       RandomAccessContainer<value_type>& seq) const {
-    return filter(seq);
+    seq.resize(point_count());
+    std::vector<value_type> work(seq.begin(), seq.end());
+    transform(work.data(), inverse_roots_);
+    for (size_type i = 0; i < work.size(); ++i)
+      seq[i] = mul(work[i], inverse_len_);
+    return seq;
+  }
+
+  // in-place transform of data[0, point_count()), no scaling
+  void filter(value_type* data) const { transform(data, roots_); }
+  void inverse(value_type* data) const {
+    transform(data, inverse_roots_);
+    for (size_type i = 0; i < point_count(); ++i)
+      data[i] = mul(data[i], inverse_len_);
+  }
+
+  static value_type mul(value_type a, value_type b) {
+    return value_type(std::uint64_t(a) * b % Modulus);
+  }
+
+  static value_type power(value_type base, std::uint64_t exp) {
+    value_type result = 1;
+    for (; exp > 0; exp >>= 1, base = mul(base, base)) {
+      if (exp & 0x01) result = mul(result, base);
+    }
+    return result;
   }
 
  private:
-  std::vector<value_type> omega_;
-  std::vector<size_type> index_;
+  void transform(value_type* data,
+                 const std::vector<value_type>& roots) const {
+    size_type len = point_count();
+    for (size_type i = 1, j = 0; i < len; ++i) {  // bit reversal
+      size_type bit = len >> 1;
+      for (; j & bit; bit >>= 1) j ^= bit;
+      j ^= bit;
+      if (i < j) std::swap(data[i], data[j]);
+    }
+    for (size_type half = 1; half < len; half <<= 1) {
+      const value_type* w = roots.data() + half;
+      for (size_type base = 0; base < len; base += half << 1) {
+        value_type* left = data + base;
+        value_type* right = left + half;
+        for (size_type i = 0; i < half; ++i) {
+          value_type t = mul(right[i], w[i]);
+          value_type u = left[i];
+          left[i] = u + t >= Modulus ? u + t - Modulus : u + t;
+          right[i] = u >= t ? u - t : u + Modulus - t;
+        }
+      }
+    }
+  }
+
+ private:
+  std::vector<value_type> roots_;
+  std::vector<value_type> inverse_roots_;
+  value_type inverse_len_;
 };
 
+// linear convolution of real sequences [first1, last1) and [first2, last2)
+// by real input transforms, writes (last1-first1)+(last2-first2)-1 values to
+// result and returns end of them; empty input produces no output.
+template <typename InputIterator1, typename InputIterator2,
+          typename OutputIterator>
+OutputIterator convolve(InputIterator1 first1, InputIterator1 last1,
+                        InputIterator2 first2, InputIterator2 last2,
+                        OutputIterator result) {
+  typedef typename std::iterator_traits<InputIterator1>::value_type float_type;
+  typedef std::complex<float_type> value_type;
+  std::vector<float_type> seq1(first1, last1), seq2(first2, last2);
+  if (seq1.empty() || seq2.empty()) return result;
+
+  std::size_t result_len = seq1.size() + seq2.size() - 1, len = 2;
+  while (len < result_len) len <<= 1;
+  Filter<float_type> f;
+  f.establish(len);
+  std::vector<value_type> spectrum1, spectrum2;
+  f.filter_real(seq1, spectrum1);
+  f.filter_real(seq2, spectrum2);
+  for (std::size_t k = 0; k < spectrum1.size(); ++k)
+    spectrum1[k] *= spectrum2[k];
+  f.inverse_real(spectrum1, seq1);
+  return std::copy(seq1.begin(), seq1.begin() + result_len, result);
+}
+
+namespace internal {
+
+// primes p == k * 2^n + 1 with primitive root 3
+enum : std::uint32_t {
+  NTT_PRIME1 = 998244353,  // 119 * 2^23 + 1
+  NTT_PRIME2 = 167772161,  // 5 * 2^25 + 1
+  NTT_PRIME3 = 469762049,  // 7 * 2^26 + 1
+  NTT_ROOT = 3
+};
+
+template <std::uint32_t Modulus>
+void ntt_convolve_prime(const std::vector<std::uint64_t>& seq1,
+                  const std::vector<std::uint64_t>& seq2, std::size_t len,
+                  std::vector<std::uint32_t>& result) {
+  typedef ModularFilter<Modulus, NTT_ROOT> filter_type;
+  filter_type f;
+  f.establish(len);
+  std::vector<std::uint32_t> work(f.point_count());
+  result.assign(f.point_count(), 0);
+  for (std::size_t i = 0; i < seq1.size(); ++i) result[i] = seq1[i] % Modulus;
+  for (std::size_t i = 0; i < seq2.size(); ++i) work[i] = seq2[i] % Modulus;
+  f.filter(result.data());
+  f.filter(work.data());
+  for (std::size_t i = 0; i < work.size(); ++i)
+    result[i] = filter_type::mul(result[i], work[i]);
+  f.inverse(result.data());
+}
+
+}  // namespace internal
+
+// exclusive upper bound of values ntt_convolve() can produce exactly
+inline unsigned __int128 ntt_convolve_limit() {
+  return (unsigned __int128)internal::NTT_PRIME1 * internal::NTT_PRIME2 *
+         internal::NTT_PRIME3;
+}
+
+// longest result ntt_convolve() can produce
+inline std::size_t ntt_convolve_max_length() {
+  return ModularFilter<internal::NTT_PRIME1, internal::NTT_ROOT>::
+      max_point_count();
+}
+
+// exact linear convolution of non-negative integer sequences [first1, last1)
+// and [first2, last2), by number theoretic transforms over three primes
+// combined with chinese remainder theorem. writes unsigned __int128 values,
+// (last1-first1)+(last2-first2)-1 of them, to result and returns end of them.
+// pre-condition: every convolution value is less than ntt_convolve_limit()
+// pre-condition: result length is not larger than ntt_convolve_max_length()
+template <typename InputIterator1, typename InputIterator2,
+          typename OutputIterator>
+OutputIterator ntt_convolve(InputIterator1 first1, InputIterator1 last1,
+                            InputIterator2 first2, InputIterator2 last2,
+                            OutputIterator result) {
+  using internal::NTT_PRIME1;
+  using internal::NTT_PRIME2;
+  using internal::NTT_PRIME3;
+  using internal::NTT_ROOT;
+  std::vector<std::uint64_t> seq1(first1, last1), seq2(first2, last2);
+  if (seq1.empty() || seq2.empty()) return result;
+  std::size_t result_len = seq1.size() + seq2.size() - 1;
+  if (result_len > ntt_convolve_max_length()) {
+    throw std::length_error("ntt_convolve(...): sequences too long");
+  }
+
+  std::vector<std::uint32_t> r1, r2, r3;
+  internal::ntt_convolve_prime<NTT_PRIME1>(seq1, seq2, result_len, r1);
+  internal::ntt_convolve_prime<NTT_PRIME2>(seq1, seq2, result_len, r2);
+  internal::ntt_convolve_prime<NTT_PRIME3>(seq1, seq2, result_len, r3);
+
+  // garner: x = r1 + p1 * k2 + p1 * p2 * k3
+  typedef ModularFilter<NTT_PRIME2, NTT_ROOT> filter2;
+  typedef ModularFilter<NTT_PRIME3, NTT_ROOT> filter3;
+  const std::uint64_t p12 = std::uint64_t(NTT_PRIME1) * NTT_PRIME2;
+  const std::uint32_t inv1_mod2 = filter2::power(NTT_PRIME1, NTT_PRIME2 - 2);
+  const std::uint32_t inv12_mod3 =
+      filter3::power(std::uint32_t(p12 % NTT_PRIME3), NTT_PRIME3 - 2);
+  for (std::size_t i = 0; i < result_len; ++i, ++result) {
+    std::uint32_t k2 = filter2::mul(
+        (r2[i] + NTT_PRIME2 - r1[i] % NTT_PRIME2) % NTT_PRIME2, inv1_mod2);
+    std::uint64_t x12 = r1[i] + std::uint64_t(NTT_PRIME1) * k2;  // < p1 * p2
+    std::uint32_t k3 = filter3::mul(
+        (r3[i] + NTT_PRIME3 - std::uint32_t(x12 % NTT_PRIME3)) % NTT_PRIME3,
+        inv12_mod3);
+    *result = x12 + (unsigned __int128)p12 * k3;
+  }
+  return result;
+}
+
 }  // namespace fft
 
 #endif  // FFT_H_
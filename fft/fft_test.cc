@@ -32,3 +32,248 @@ TEST(FilterTest, ItWorks) {
 
   EXPECT_THAT(f(seqb), ElementsAreArray({0, 0, 4, 0, 0, 0, 4, 0}));
 }
+
+TEST(FilterTest, Inverse) {
+  fft::Filter<double> f;
+  std::vector<std::complex<double> > seq;
+  for (int i = 0; i < 13; ++i) {
+    seq.push_back(std::complex<double>(std::sin(i * 0.7), std::cos(i * 1.3)));
+  }
+  std::vector<std::complex<double> > seqb(seq);
+
+  f.establish(seq.size());
+  f.inverse(f.filter(seq));
+  ASSERT_EQ(seq.size(), seqb.size());
+  for (std::size_t i = 0; i < seq.size(); ++i) {
+    EXPECT_NEAR(seq[i].real(), seqb[i].real(), 1e-12) << "i=" << i;
+    EXPECT_NEAR(seq[i].imag(), seqb[i].imag(), 1e-12) << "i=" << i;
+  }
+}
+
+TEST(FilterTest, FilterReal) {
+  fft::Filter<double> f;
+  std::vector<double> seq;
+  std::vector<std::complex<double> > seqc;
+  for (int i = 0; i < 32; ++i) {
+    seq.push_back(std::sin(i * 0.3) + 0.5 * std::cos(i * 2.1) + i % 3);
+    seqc.push_back(std::complex<double>(seq.back()));
+  }
+
+  f.establish(seq.size());
+  std::deque<std::complex<double> > spectrum;
+  f.filter_real(seq, spectrum);
+  f.filter(seqc);
+  ASSERT_EQ(spectrum.size(), 17);
+  for (std::size_t i = 0; i < spectrum.size(); ++i) {
+    EXPECT_NEAR(spectrum[i].real(), seqc[i].real(), 1e-9) << "i=" << i;
+    EXPECT_NEAR(spectrum[i].imag(), seqc[i].imag(), 1e-9) << "i=" << i;
+  }
+
+  std::vector<double> seqb;
+  f.inverse_real(spectrum, seqb);
+  ASSERT_EQ(seqb.size(), seq.size());
+  for (std::size_t i = 0; i < seq.size(); ++i) {
+    EXPECT_NEAR(seqb[i], seq[i], 1e-12) << "i=" << i;
+  }
+}
+
+TEST(FilterTest, FilterRealShortest) {
+  fft::Filter<double> f;
+  f.establish(1);
+  std::vector<double> seq(1, 3.0);
+  std::vector<std::complex<double> > spectrum;
+  f.filter_real(seq, spectrum);
+  EXPECT_THAT(spectrum, ElementsAreArray({3.0}));
+  std::vector<double> seqb;
+  EXPECT_THAT(f.inverse_real(spectrum, seqb), ElementsAreArray({3.0}));
+}
+
+std::vector<std::complex<double> > Dft(
+    const std::vector<std::complex<double> >& seq) {
+  std::size_t len = seq.size();
+  std::vector<std::complex<double> > result(len);
+  for (std::size_t k = 0; k < len; ++k) {
+    for (std::size_t i = 0; i < len; ++i) {
+      double phase = -2 * M_PI * (double)(i * k % len) / len;
+      result[k] += seq[i] * std::complex<double>(cos(phase), sin(phase));
+    }
+  }
+  return result;
+}
+
+TEST(FilterTest, ArbitraryLength) {
+  // smooth, generic radix, large prime (Bluestein) and mixed lengths
+  const std::size_t lengths[] = {1,  2,  3,   5,   6,   12,  15,  30,
+                                 49, 60, 100, 101, 210, 257, 300, 1000};
+  for (std::size_t len : lengths) {
+    std::vector<std::complex<double> > seq;
+    for (std::size_t i = 0; i < len; ++i) {
+      seq.push_back(std::complex<double>(std::sin(i * 0.37) + i % 5,
+                                         std::cos(i * 1.9)));
+    }
+    std::vector<std::complex<double> > expected = Dft(seq);
+    std::vector<std::complex<double> > seqb(seq);
+
+    fft::Filter<double> f;
+    f.establish(len);
+    ASSERT_EQ(f.point_count(), len);
+    f.filter(seqb);
+    ASSERT_EQ(seqb.size(), len);
+    for (std::size_t i = 0; i < len; ++i) {
+      EXPECT_NEAR(seqb[i].real(), expected[i].real(), 1e-8)
+          << "len=" << len << " i=" << i;
+      EXPECT_NEAR(seqb[i].imag(), expected[i].imag(), 1e-8)
+          << "len=" << len << " i=" << i;
+    }
+
+    f.inverse(seqb);
+    for (std::size_t i = 0; i < len; ++i) {
+      EXPECT_NEAR(seqb[i].real(), seq[i].real(), 1e-10)
+          << "len=" << len << " i=" << i;
+      EXPECT_NEAR(seqb[i].imag(), seq[i].imag(), 1e-10)
+          << "len=" << len << " i=" << i;
+    }
+
+    std::vector<double> real_seq, real_seqb;
+    for (std::size_t i = 0; i < len; ++i) real_seq.push_back(seq[i].real());
+    std::vector<std::complex<double> > spectrum;
+    f.filter_real(real_seq, spectrum);
+    ASSERT_EQ(spectrum.size(), len / 2 + 1);
+    f.inverse_real(spectrum, real_seqb);
+    ASSERT_EQ(real_seqb.size(), len);
+    for (std::size_t i = 0; i < len; ++i) {
+      EXPECT_NEAR(real_seqb[i], real_seq[i], 1e-10)
+          << "len=" << len << " i=" << i;
+    }
+  }
+}
+
+TEST(FilterTest, MultithreadedTransform) {
+  // smooth length and Bluestein length above the parallel threshold
+  for (std::size_t len : {3 << 14, 40009}) {
+    std::vector<std::complex<double> > seq;
+    for (std::size_t i = 0; i < len; ++i) {
+      seq.push_back(std::complex<double>(std::sin(i * 0.01) + i % 11, 0.5));
+    }
+    std::vector<std::complex<double> > seqb(seq);
+
+    fft::Filter<double> f;
+    f.establish(len);
+    f.filter(seq);
+    f.filter(seqb, 4);
+    for (std::size_t i = 0; i < len; ++i) {
+      ASSERT_NEAR(std::abs(seqb[i] - seq[i]), 0.0, 1e-9) << "i=" << i;
+    }
+    f.inverse(seqb, 3);
+    for (std::size_t i = 0; i < len; ++i) {
+      ASSERT_NEAR(seqb[i].real(), std::sin(i * 0.01) + i % 11, 1e-9);
+      ASSERT_NEAR(seqb[i].imag(), 0.5, 1e-9);
+    }
+  }
+}
+
+TEST(FilterTest, Batch) {
+  const std::size_t len = 30, stride = 32, count = 7;
+  fft::Filter<double> f;
+  f.establish(len);
+
+  std::vector<std::complex<double> > data(stride * count);
+  std::vector<double> real_data(stride * count);
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    real_data[i] = std::cos(i * 0.21) * (i % 4);
+    data[i] = std::complex<double>(real_data[i], std::sin(i * 0.5));
+  }
+  std::vector<std::complex<double> > datab(data);
+
+  f.filter_batch(datab.data(), stride, count, 3);
+  for (std::size_t n = 0; n < count; ++n) {
+    std::vector<std::complex<double> > seq(data.begin() + n * stride,
+                                           data.begin() + n * stride + len);
+    f.filter(seq);
+    for (std::size_t i = 0; i < len; ++i) {
+      EXPECT_NEAR(std::abs(datab[n * stride + i] - seq[i]), 0.0, 1e-12);
+    }
+    // padding between sequences is untouched
+    for (std::size_t i = len; i < stride; ++i) {
+      EXPECT_EQ(datab[n * stride + i], data[n * stride + i]);
+    }
+  }
+  f.inverse_batch(datab.data(), stride, count, 2);
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    EXPECT_NEAR(std::abs(datab[i] - data[i]), 0.0, 1e-12) << "i=" << i;
+  }
+
+  const std::size_t spectrum_len = len / 2 + 1;
+  std::vector<std::complex<double> > spectra(spectrum_len * count);
+  f.filter_real_batch(real_data.data(), stride, spectra.data(), spectrum_len,
+                      count, 4);
+  for (std::size_t n = 0; n < count; ++n) {
+    std::vector<double> seq(real_data.begin() + n * stride,
+                            real_data.begin() + n * stride + len);
+    std::vector<std::complex<double> > spectrum;
+    f.filter_real(seq, spectrum);
+    for (std::size_t k = 0; k < spectrum_len; ++k) {
+      EXPECT_NEAR(std::abs(spectra[n * spectrum_len + k] - spectrum[k]), 0.0,
+                  1e-12);
+    }
+  }
+  std::vector<double> real_datab(len * count);
+  f.inverse_real_batch(spectra.data(), spectrum_len, real_datab.data(), len,
+                       count, 0);
+  for (std::size_t n = 0; n < count; ++n) {
+    for (std::size_t i = 0; i < len; ++i) {
+      EXPECT_NEAR(real_datab[n * len + i], real_data[n * stride + i], 1e-12);
+    }
+  }
+}
+
+TEST(ModularFilterTest, ItWorks) {
+  fft::ModularFilter<998244353, 3> f;
+  EXPECT_EQ(f.max_point_count(), 1 << 23);
+  f.establish(5);
+  EXPECT_EQ(f.point_count(), 8);
+
+  std::vector<std::uint32_t> seq = {1, 2, 3, 4, 5};
+  std::deque<std::uint32_t> seqb(seq.begin(), seq.end());
+  f.filter(seqb);
+  EXPECT_EQ(seqb[0], 15);
+  f.inverse(seqb);
+  EXPECT_THAT(seqb, ElementsAreArray({1, 2, 3, 4, 5, 0, 0, 0}));
+}
+
+TEST(ConvolveTest, Real) {
+  std::vector<double> seq1 = {1, 2, 3}, seq2 = {0.5, -1, 0, 2}, result;
+  fft::convolve(seq1.begin(), seq1.end(), seq2.begin(), seq2.end(),
+                std::back_inserter(result));
+  const double expected[] = {0.5, 0, -0.5, -1, 4, 6};
+  ASSERT_EQ(result.size(), 6);
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    EXPECT_NEAR(result[i], expected[i], 1e-12) << "i=" << i;
+  }
+
+  result.clear();
+  fft::convolve(seq1.begin(), seq1.begin(), seq2.begin(), seq2.end(),
+                std::back_inserter(result));
+  EXPECT_TRUE(result.empty());
+}
+
+TEST(ConvolveTest, Exact) {
+  // values near 2^32 make products overflow 64 bits
+  std::vector<std::uint64_t> seq1, seq2;
+  for (std::uint64_t i = 0; i < 1000; ++i) {
+    seq1.push_back(0xFFFFFFFFull - i * 7919);
+    seq2.push_back(i * i * 104729 % 0xFFFFFFFFull);
+  }
+  std::vector<unsigned __int128> result(seq1.size() + seq2.size() - 1);
+  EXPECT_EQ(fft::ntt_convolve(seq1.begin(), seq1.end(), seq2.begin(),
+                              seq2.end(), result.begin()),
+            result.end());
+  for (std::size_t k = 0; k < result.size(); k += 37) {
+    unsigned __int128 expected = 0;
+    for (std::size_t i = 0; i <= k && i < seq1.size(); ++i) {
+      if (k - i < seq2.size())
+        expected += (unsigned __int128)seq1[i] * seq2[k - i];
+    }
+    EXPECT_TRUE(result[k] == expected) << "k=" << k;
+  }
+}
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "crosslist/crosslist.h"
+#include "tree/tree.h"
 
 namespace graph {
 
@@ -330,23 +331,20 @@ void dijkstra(const CrossList<T>& g, vertex_type s, RandomAccessIterator1 prev,
     throw std::out_of_range("s is not a valid vertex in g");
   }
 
-  // use priority_queue to arrange vertices by their states
+  // addressable heap of tentative distances, first by pred on top, so a
+  //  vertex is queued at most once and its distance adjusted in place
   typedef T dist_type;
-  typedef WeightedVertex<dist_type> weighted_vertex;
-  typedef WeightedReverseCompare<BinaryPredicate> reverse_compare;
-  std::priority_queue<weighted_vertex, std::vector<weighted_vertex>,
-                      reverse_compare>
-      states(make_weighted_rcompare(pred));
+  auto reverse_pred = [&pred](const dist_type& lhs, const dist_type& rhs) {
+    return pred(rhs, lhs);
+  };
+  tree::heap::IndexedHeap<dist_type, decltype(reverse_pred)> states(
+      g.column_count(), reverse_pred);
   prev[s] = s;
   dist[s] = 0;
-  states.push(make_weighted_vertex(dist[s], s));
+  states.push(s, dist[s]);
   while (!states.empty()) {
-    dist_type d = states.top().weight;
-    vertex_type v = states.top().vertex;
+    vertex_type v = states.top();
     states.pop();
-    if (dist[v] < d) {
-      continue;  // already adjusted by other states
-    }
 
     // check on outdegree vertices adjacent to current nearest vertex
     typename CrossList<T>::const_row_iterator row_iter, row_end;
@@ -358,7 +356,7 @@ void dijkstra(const CrossList<T>& g, vertex_type s, RandomAccessIterator1 prev,
       if (pred(dist[v] + dvw, dist[w])) {
         prev[w] = v;
         dist[w] = dist[v] + dvw;
-        states.push(make_weighted_vertex(dist[w], w));
+        states.push_or_update(w, dist[w]);
       }
     }
   }
@@ -0,0 +1,76 @@
+// Implements minimal fork-join helpers shared by multithreaded algorithms
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// number of concurrent threads supported by hardware, at least 1
+inline std::size_t hardware_concurrency() {
+  std::size_t count = std::thread::hardware_concurrency();
+  return count > 0 ? count : 1;
+}
+
+// resolve requested thread count: 0 means hardware_concurrency(), and never
+// more threads than work items
+inline std::size_t thread_count(std::size_t requested, std::size_t work_count) {
+  std::size_t count = requested > 0 ? requested : hardware_concurrency();
+  if (count > work_count) count = work_count;
+  return count > 0 ? count : 1;
+}
+
+// split [0, count) into thread_count(requested, count) contiguous ranges of
+// near equal length and call function(begin, end, range_index) on each,
+// the calling thread takes the first range.
+// remarks: all ranges complete before return, the first exception thrown by
+//  any range is rethrown to the caller. if a thread cannot be started, the
+//  started ones are joined and the error is rethrown, no range is retried.
+template <typename Function>
+void for_each_range(std::size_t count, std::size_t requested,
+                    Function function) {
+  if (0 == count) return;
+  std::size_t ranges = thread_count(requested, count);
+  if (1 == ranges) {
+    function(std::size_t(0), count, std::size_t(0));
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(ranges);
+  std::vector<std::thread> threads;
+  threads.reserve(ranges - 1);
+  std::size_t step = count / ranges, extra = count % ranges;
+  std::size_t begin = step + (extra > 0 ? 1 : 0);  // first range for caller
+  try {
+    for (std::size_t i = 1; i < ranges; ++i) {
+      std::size_t end = begin + step + (i < extra ? 1 : 0);
+      threads.push_back(std::thread([&function, &errors, begin, end, i]() {
+        try {
+          function(begin, end, i);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      }));
+      begin = end;
+    }
+  } catch (...) {  // e.g. std::system_error when out of thread resources
+    for (std::size_t i = 0; i < threads.size(); ++i) threads[i].join();
+    throw;
+  }
+  try {
+    function(std::size_t(0), step + (extra > 0 ? 1 : 0), std::size_t(0));
+  } catch (...) {
+    errors[0] = std::current_exception();
+  }
+  for (std::size_t i = 0; i < threads.size(); ++i) threads[i].join();
+  for (std::size_t i = 0; i < ranges; ++i) {
+    if (errors[i]) std::rethrow_exception(errors[i]);
+  }
+}
+
+}  // namespace parallel
+
+#endif  // PARALLEL_H_
@@ -0,0 +1,48 @@
+#include "parallel/parallel.h"
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::Each;
+
+TEST(ThreadCountTest, Resolve) {
+  EXPECT_EQ(parallel::thread_count(4, 100), 4);
+  EXPECT_EQ(parallel::thread_count(4, 2), 2);
+  EXPECT_EQ(parallel::thread_count(4, 0), 1);
+  EXPECT_EQ(parallel::thread_count(0, 1), 1);
+  EXPECT_GE(parallel::thread_count(0, 1000), 1);
+  EXPECT_LE(parallel::thread_count(0, 1000), parallel::hardware_concurrency());
+}
+
+TEST(ForEachRangeTest, CoversAllOnce) {
+  for (std::size_t count : {0, 1, 7, 100, 1001}) {
+    for (std::size_t threads : {1, 2, 3, 8}) {
+      std::vector<int> visits(count, 0);
+      std::atomic<std::size_t> ranges(0);
+      parallel::for_each_range(
+          count, threads,
+          [&](std::size_t begin, std::size_t end, std::size_t index) {
+            EXPECT_LT(index, threads);
+            EXPECT_LT(begin, end);
+            for (std::size_t i = begin; i < end; ++i) ++visits[i];
+            ++ranges;
+          });
+      EXPECT_THAT(visits, Each(1)) << "count=" << count;
+      EXPECT_EQ(ranges, parallel::thread_count(threads, count) * (count > 0));
+    }
+  }
+}
+
+TEST(ForEachRangeTest, RethrowsException) {
+  EXPECT_THROW(parallel::for_each_range(
+                   100, 4,
+                   [](std::size_t begin, std::size_t, std::size_t) {
+                     if (begin > 0) throw std::runtime_error("range");
+                   }),
+               std::runtime_error);
+}
@@ -2,13 +2,41 @@
 #define SORTING_H_
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <istream>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "parallel/parallel.h"
 #include "tree/tree.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
 namespace sorting {
 
 template <typename ForwardIterator, typename BinaryPredicate>
@@ -262,6 +290,277 @@ RandomAccessIterator median3(RandomAccessIterator first,
   return center;
 }
 
+// sorting networks
+// bitonic networks of 8 to SORT_SMALL_MAX elements on SIMD lanes, branch free
+// replacement of insertion sort for small partitions of int32, int64, float
+// and double under std::less.
+// -----------------------------------------------------------------------------
+
+enum {
+  SORT_SMALL_MAX = 64,       // elements of the largest network
+  NETWORK_SORT_CUTOFF = 32,  // partitions smaller take a network
+};
+
+// lanes of a SIMD register, Vectorized is false if no network is provided
+// for elements of T
+template <typename T, typename Enable = void>
+struct NetworkLanes {
+  static const bool vectorized = false;
+};
+
+#if defined(__SSE2__)
+// lane masks of bitonic stage (j, k) for lanes [base, base + 4): a lane
+// keeps the minimum if it is the lower one of its pair in an ascending block,
+// or the upper one in a descending block
+inline __m128i network_mask4(std::size_t base, std::size_t j, std::size_t k) {
+  const __m128i lane = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(base)),
+                                     _mm_setr_epi32(0, 1, 2, 3));
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lower = _mm_cmpeq_epi32(
+      _mm_and_si128(lane, _mm_set1_epi32(static_cast<int>(j))), zero);
+  __m128i ascending = _mm_cmpeq_epi32(
+      _mm_and_si128(lane, _mm_set1_epi32(static_cast<int>(k))), zero);
+  return _mm_cmpeq_epi32(lower, ascending);
+}
+
+inline __m128i network_mask2(std::size_t base, std::size_t k) {
+  // j is 1 in the only in-register stage of two lanes
+  long long lane0 = (base & k) == 0 ? -1 : 0;
+  return _mm_set_epi64x(~lane0, lane0);
+}
+
+inline __m128i network_select(__m128i mask, __m128i lhs, __m128i rhs) {
+  return _mm_or_si128(_mm_and_si128(mask, lhs), _mm_andnot_si128(mask, rhs));
+}
+
+template <typename T>
+struct NetworkLanes<T, typename std::enable_if<std::is_integral<T>::value &&
+                                               std::is_signed<T>::value &&
+                                               sizeof(T) == 4>::type> {
+  static const bool vectorized = true;
+  typedef __m128i vector_type;
+  enum { WIDTH = 4 };
+
+  static vector_type load(const T* p) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void store(T* p, vector_type v) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static vector_type min(vector_type a, vector_type b) {
+#if defined(__SSE4_1__)
+    return _mm_min_epi32(a, b);
+#else
+    return network_select(_mm_cmpgt_epi32(b, a), a, b);
+#endif
+  }
+  static vector_type max(vector_type a, vector_type b) {
+#if defined(__SSE4_1__)
+    return _mm_max_epi32(a, b);
+#else
+    return network_select(_mm_cmpgt_epi32(b, a), b, a);
+#endif
+  }
+  // v with lanes of distance j swapped, j < WIDTH
+  static vector_type partner(vector_type v, std::size_t j) {
+    return 1 == j ? _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1))
+                  : _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+  }
+  static vector_type stage(vector_type v, std::size_t base, std::size_t j,
+                           std::size_t k) {
+    vector_type u = partner(v, j);
+    return network_select(network_mask4(base, j, k), min(v, u), max(v, u));
+  }
+};
+
+template <typename T>
+struct NetworkLanes<T, typename std::enable_if<std::is_integral<T>::value &&
+                                               std::is_signed<T>::value &&
+                                               sizeof(T) == 8>::type> {
+  static const bool vectorized = true;
+  typedef __m128i vector_type;
+  enum { WIDTH = 2 };
+
+  static vector_type load(const T* p) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void store(T* p, vector_type v) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  // lanes where a > b
+  static vector_type greater(vector_type a, vector_type b) {
+#if defined(__SSE4_2__)
+    return _mm_cmpgt_epi64(a, b);
+#else
+    // high halves compare signed, low halves unsigned when high ones equal
+    const __m128i bias = _mm_set_epi32(0, INT_MIN, 0, INT_MIN);
+    __m128i hi_gt = _mm_cmpgt_epi32(a, b), hi_eq = _mm_cmpeq_epi32(a, b);
+    __m128i lo_gt = _mm_cmpgt_epi32(_mm_xor_si128(a, bias),
+                                    _mm_xor_si128(b, bias));
+    lo_gt = _mm_shuffle_epi32(lo_gt, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i gt = _mm_or_si128(hi_gt, _mm_and_si128(hi_eq, lo_gt));
+    return _mm_shuffle_epi32(gt, _MM_SHUFFLE(3, 3, 1, 1));
+#endif
+  }
+  static vector_type min(vector_type a, vector_type b) {
+    return network_select(greater(b, a), a, b);
+  }
+  static vector_type max(vector_type a, vector_type b) {
+    return network_select(greater(b, a), b, a);
+  }
+  static vector_type stage(vector_type v, std::size_t base, std::size_t,
+                           std::size_t k) {
+    vector_type u = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    return network_select(network_mask2(base, k), min(v, u), max(v, u));
+  }
+};
+
+template <>
+struct NetworkLanes<float> {
+  static const bool vectorized = true;
+  typedef __m128 vector_type;
+  enum { WIDTH = 4 };
+
+  static vector_type load(const float* p) { return _mm_load_ps(p); }
+  static void store(float* p, vector_type v) { _mm_store_ps(p, v); }
+  static vector_type select(vector_type mask, vector_type lhs,
+                            vector_type rhs) {
+    return _mm_or_ps(_mm_and_ps(mask, lhs), _mm_andnot_ps(mask, rhs));
+  }
+  // unlike _mm_min_ps/_mm_max_ps, a is kept when a and b compare equal
+  // (-0.0 and +0.0) or unordered, so elements are moved, never recomputed
+  static vector_type min(vector_type a, vector_type b) {
+    return select(_mm_cmplt_ps(b, a), b, a);
+  }
+  static vector_type max(vector_type a, vector_type b) {
+    return select(_mm_cmplt_ps(a, b), b, a);
+  }
+  static vector_type stage(vector_type v, std::size_t base, std::size_t j,
+                           std::size_t k) {
+    vector_type u = 1 == j ? _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))
+                           : _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128 mask = _mm_castsi128_ps(network_mask4(base, j, k));
+    return select(mask, min(v, u), max(v, u));
+  }
+};
+
+template <>
+struct NetworkLanes<double> {
+  static const bool vectorized = true;
+  typedef __m128d vector_type;
+  enum { WIDTH = 2 };
+
+  static vector_type load(const double* p) { return _mm_load_pd(p); }
+  static void store(double* p, vector_type v) { _mm_store_pd(p, v); }
+  static vector_type select(vector_type mask, vector_type lhs,
+                            vector_type rhs) {
+    return _mm_or_pd(_mm_and_pd(mask, lhs), _mm_andnot_pd(mask, rhs));
+  }
+  // a is kept when a and b compare equal or unordered, see float
+  static vector_type min(vector_type a, vector_type b) {
+    return select(_mm_cmplt_pd(b, a), b, a);
+  }
+  static vector_type max(vector_type a, vector_type b) {
+    return select(_mm_cmplt_pd(a, b), b, a);
+  }
+  static vector_type stage(vector_type v, std::size_t base, std::size_t,
+                           std::size_t k) {
+    vector_type u = _mm_shuffle_pd(v, v, 1);
+    __m128d mask = _mm_castsi128_pd(network_mask2(base, k));
+    return select(mask, min(v, u), max(v, u));
+  }
+};
+#endif
+
+// bitonic sort of a[0, N) ascending, N is a power of 2 and a multiple of
+// Lanes::WIDTH, a is aligned to 16 bytes
+template <typename Lanes, std::size_t N, typename T>
+void bitonic_sort(T* a) {
+  typedef typename Lanes::vector_type vector_type;
+  const std::size_t width = Lanes::WIDTH;
+  for (std::size_t k = 2; k <= N; k <<= 1) {
+    for (std::size_t j = k >> 1; j > 0; j >>= 1) {
+      if (j < width) {  // pairs inside one register
+        for (std::size_t b = 0; b < N; b += width) {
+          Lanes::store(a + b, Lanes::stage(Lanes::load(a + b), b, j, k));
+        }
+        continue;
+      }
+      for (std::size_t b = 0; b < N; b += 2 * j) {
+        const bool ascending = (b & k) == 0;
+        for (std::size_t t = b; t < b + j; t += width) {
+          vector_type x = Lanes::load(a + t), y = Lanes::load(a + t + j);
+          // min and max keep their first operand on ties, so swapping the
+          // operands of max takes x and y once each, even for -0.0 and +0.0
+          vector_type lo = Lanes::min(x, y), hi = Lanes::max(y, x);
+          Lanes::store(a + t, ascending ? lo : hi);
+          Lanes::store(a + t + j, ascending ? hi : lo);
+        }
+      }
+    }
+  }
+}
+
+// sort n elements of [first, first + n) in a network of N elements, padded
+// with the largest value
+template <std::size_t N, typename RandomAccessIterator>
+void network_sort(RandomAccessIterator first, std::size_t n) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  typedef std::numeric_limits<value_type> limits;
+  alignas(16) value_type a[N];
+  for (std::size_t i = 0; i < n; ++i) a[i] = first[i];
+  for (std::size_t i = n; i < N; ++i) {
+    a[i] = limits::has_infinity ? limits::infinity() : limits::max();
+  }
+  bitonic_sort<NetworkLanes<value_type>, N>(a);
+  for (std::size_t i = 0; i < n; ++i) first[i] = a[i];
+}
+
+// whether [first, last) sorted by pred takes a network
+template <typename RandomAccessIterator, typename BinaryPredicate>
+struct is_network_sortable : std::false_type {};
+
+template <typename RandomAccessIterator, typename T>
+struct is_network_sortable<RandomAccessIterator, std::less<T> >
+    : std::integral_constant<
+          bool, std::is_same<typename std::iterator_traits<
+                                 RandomAccessIterator>::value_type,
+                             T>::value &&
+                    NetworkLanes<T>::vectorized> {};
+
+// largest partition left to small_sort() by quick sorts
+template <typename RandomAccessIterator, typename BinaryPredicate>
+struct small_sort_cutoff
+    : std::integral_constant<
+          std::ptrdiff_t,
+          is_network_sortable<RandomAccessIterator, BinaryPredicate>::value
+              ? NETWORK_SORT_CUTOFF
+              : QUICK_SORT_CUTOFF_RANGE> {};
+
+// sort a small range, at most SORT_SMALL_MAX elements if network sortable
+template <typename RandomAccessIterator, typename BinaryPredicate>
+void small_sort(RandomAccessIterator first, RandomAccessIterator last,
+                BinaryPredicate pred) {
+  if constexpr (is_network_sortable<RandomAccessIterator,
+                                    BinaryPredicate>::value) {
+    const std::size_t n = last - first;
+    if (n <= 1) {
+      return;
+    } else if (n <= 8) {
+      network_sort<8>(first, n);
+    } else if (n <= 16) {
+      network_sort<16>(first, n);
+    } else if (n <= 32) {
+      network_sort<32>(first, n);
+    } else {
+      network_sort<64>(first, n);
+    }
+  } else {
+    insertion_sort(first, last, pred);
+  }
+}
+
 }  // namespace internal
 
 template <typename RandomAccessIterator, typename BinaryPredicate>
@@ -271,17 +570,22 @@ void quick_sort(RandomAccessIterator first, RandomAccessIterator last,
     return;
   }
 
-  // small amount array use insertion_sort
-  if (last - first <= internal::QUICK_SORT_CUTOFF_RANGE) {
-    insertion_sort(first, last, pred);
+  // small amount array use insertion_sort, or a sorting network
+  typedef internal::small_sort_cutoff<RandomAccessIterator, BinaryPredicate>
+      cutoff;
+  if (last - first <= cutoff::value) {
+    internal::small_sort(first, last, pred);
     return;
   }
 
   // quick sort algorithm (pre-condition: last-first>=2)
-  RandomAccessIterator center = internal::median3(first, last, pred);
-  center = sorting::partition(
+  // pivot is copied, partition may move the median away from center
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  const value_type pivot = *internal::median3(first, last, pred);
+  RandomAccessIterator center = sorting::partition(
       first + 1, last - 1,
-      [&](const decltype(*center)& value) { return pred(value, *center); });
+      [&](const value_type& value) { return pred(value, pivot); });
   sorting::quick_sort(first, center, pred);
   sorting::quick_sort(center, last, pred);
 }
@@ -295,55 +599,291 @@ void quick_sort(RandomAccessIterator first, RandomAccessIterator last) {
 
 namespace internal {
 
-template <typename BinaryPredicate, typename Iterator>
-class IndirectCompare : public std::binary_function<Iterator, Iterator, bool> {
- public:
-  IndirectCompare(BinaryPredicate pred) : pred_(pred) {}
-  bool operator()(const Iterator& lhs, const Iterator& rhs) const {
-    return pred_(*lhs, *rhs);
+// partition [first, last) around the median of first, center and last - 1,
+// return cut so that !pred(*cut_right, pivot) for all of [cut, last) and
+// !pred(pivot, *cut_left) for all of [first, cut), first < cut < last.
+// remarks: the pivot is kept at *first during the scans, and both scans stop
+//  at elements equal to it, so runs of equal keys split evenly.
+// pre-condition: last-first>=3
+template <typename RandomAccessIterator, typename BinaryPredicate>
+RandomAccessIterator partition_pivot(RandomAccessIterator first,
+                                     RandomAccessIterator last,
+                                     BinaryPredicate pred) {
+  std::iter_swap(first, median3(first, last, pred));
+  RandomAccessIterator left = first + 1, right = last;
+  while (true) {
+    while (pred(*left, *first)) ++left;  // stops at *(last-1) at latest
+    --right;
+    while (pred(*first, *right)) --right;  // stops at *first at latest
+    if (!(left < right)) {
+      return left;
+    }
+    std::iter_swap(left, right);
+    ++left;
   }
+}
 
- private:
-  BinaryPredicate pred_;
+// pre-condition: depth_limit>=0
+template <typename RandomAccessIterator, typename BinaryPredicate>
+void intro_sort(RandomAccessIterator first, RandomAccessIterator last,
+                int depth_limit, BinaryPredicate pred) {
+  while (last - first >
+         small_sort_cutoff<RandomAccessIterator, BinaryPredicate>::value) {
+    if (0 == depth_limit--) {  // too many bad pivots, bound by n*log(n)
+      sorting::heap_sort(first, last, pred);
+      return;
+    }
+    RandomAccessIterator cut = partition_pivot(first, last, pred);
+    if (cut - first < last - cut) {  // recurse into smaller part
+      intro_sort(first, cut, depth_limit, pred);
+      first = cut;
+    } else {
+      intro_sort(cut, last, depth_limit, pred);
+      last = cut;
+    }
+  }
+  small_sort(first, last, pred);
+}
+
+// 2*floor(log2(n)), the recursion depth of introsort before heap sort
+template <typename Distance>
+int intro_depth_limit(Distance n) {
+  int depth = 0;
+  for (; n > 1; n >>= 1) depth += 2;
+  return depth;
+}
+
+}  // namespace internal
+
+// quick sort with depth limit, degrades to heap sort on adversarial input,
+// so O(n*log(n)) in worst case
+template <typename RandomAccessIterator, typename BinaryPredicate>
+void intro_sort(RandomAccessIterator first, RandomAccessIterator last,
+                BinaryPredicate pred) {
+  if (last - first <= 1) {
+    return;
+  }
+  internal::intro_sort(first, last, internal::intro_depth_limit(last - first),
+                       pred);
+}
+
+template <typename RandomAccessIterator>
+void intro_sort(RandomAccessIterator first, RandomAccessIterator last) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  intro_sort(first, last, std::less<value_type>());
+}
+
+// sort [first, last) ascending, sorting networks on SIMD registers take up to
+// 64 elements of int32, int64, float or double, other ranges are intro sorted
+// remarks: NaNs are not supported
+template <typename RandomAccessIterator>
+void sort_small(RandomAccessIterator first, RandomAccessIterator last) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  typedef std::less<value_type> less_type;
+  if (internal::is_network_sortable<RandomAccessIterator, less_type>::value &&
+      last - first <= internal::SORT_SMALL_MAX) {
+    internal::small_sort(first, last, less_type());
+  } else {
+    intro_sort(first, last, less_type());
+  }
+}
+
+namespace internal {
+
+enum {
+  MIN_SORT_CHUNK = 1 << 16,  // elements per thread at least
+  SAMPLE_SORT_OVERSAMPLING = 64,  // samples per bucket
 };
 
 }  // namespace internal
 
+// sort [first, last) on /thread_count/ threads, 0 means hardware concurrency
+// remarks: sample sort. distinct splitters picked from an evenly spaced
+//  sample cut the range into buckets; each thread counts its share of
+//  elements per bucket, moves them into a buffer of (last-first) elements,
+//  then every bucket is intro sorted and moved back in parallel. elements
+//  equal to a splitter get a bucket of their own which needs no sort, so
+//  duplicate heavy keys neither pile up in one bucket nor get sorted.
+//  value_type must be default constructible for the buffer. not stable.
 template <typename RandomAccessIterator, typename BinaryPredicate>
-void indirect_sort(RandomAccessIterator first, RandomAccessIterator last,
-                   BinaryPredicate pred) {
-  // make iterator vector
-  std::vector<RandomAccessIterator> iters;
-  for (RandomAccessIterator iter = first; iter != last; ++iter) {
-    iters.push_back(iter);
+void parallel_sort(RandomAccessIterator first, RandomAccessIterator last,
+                   BinaryPredicate pred, std::size_t thread_count = 0) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  const std::size_t n = last - first;
+  const std::size_t threads = parallel::thread_count(
+      thread_count, std::max<std::size_t>(n / internal::MIN_SORT_CHUNK, 1));
+  if (threads <= 1) {
+    intro_sort(first, last, pred);
+    return;
   }
 
-  // do quick sort on iterator vector
-  quick_sort(
-      iters.begin(), iters.end(),
-      internal::IndirectCompare<BinaryPredicate, RandomAccessIterator>(pred));
+  // distinct splitters s[0] < ... < s[m-1]: bucket 2i holds elements x that
+  //  s[i-1] < x < s[i], bucket 2i+1 holds elements equal to s[i]
+  std::vector<value_type> sample;
+  const std::size_t sample_size = threads * internal::SAMPLE_SORT_OVERSAMPLING;
+  sample.reserve(sample_size);
+  for (std::size_t i = 0; i < sample_size; ++i) {
+    sample.push_back(first[(2 * i + 1) * n / (2 * sample_size)]);
+  }
+  intro_sort(sample.begin(), sample.end(), pred);
+  std::vector<value_type> splitters;
+  splitters.reserve(threads - 1);
+  for (std::size_t t = 1; t < threads; ++t) {
+    const value_type& splitter = sample[t * internal::SAMPLE_SORT_OVERSAMPLING];
+    if (splitters.empty() || pred(splitters.back(), splitter)) {
+      splitters.push_back(splitter);
+    }
+  }
+  const std::size_t buckets = 2 * splitters.size() + 1;
+  auto bucket_of = [&splitters, &pred](const value_type& value) {
+    std::size_t i =
+        std::lower_bound(splitters.begin(), splitters.end(), value, pred) -
+        splitters.begin();
+    return i < splitters.size() && !pred(value, splitters[i]) ? 2 * i + 1
+                                                              : 2 * i;
+  };
 
-  // shuffle items in place
-  typedef std::iterator_traits<RandomAccessIterator> traits;
-  typedef typename traits::value_type value_type;
-  typedef typename traits::difference_type difference_type;
-  for (difference_type i = 0, len = iters.size(); i < len; ++i) {
-    if (iters[i] == first + i) {
-      continue;  // matched, no need to move
+  // offsets[t * buckets + b]: where thread t puts its elements of bucket b
+  std::vector<std::size_t> offsets(threads * buckets, 0);
+  parallel::for_each_range(
+      n, threads, [&](std::size_t begin, std::size_t end, std::size_t t) {
+        std::size_t* counts = &offsets[t * buckets];
+        for (std::size_t i = begin; i < end; ++i) ++counts[bucket_of(first[i])];
+      });
+  std::vector<std::size_t> bounds(buckets + 1, 0);
+  for (std::size_t b = 0, offset = 0; b < buckets; ++b) {
+    bounds[b] = offset;
+    for (std::size_t t = 0; t < threads; ++t) {
+      std::size_t count = offsets[t * buckets + b];
+      offsets[t * buckets + b] = offset;
+      offset += count;
     }
+  }
+  bounds[buckets] = n;
+
+  std::vector<value_type> buffer(n);
+  parallel::for_each_range(
+      n, threads, [&](std::size_t begin, std::size_t end, std::size_t t) {
+        std::size_t* cursors = &offsets[t * buckets];
+        for (std::size_t i = begin; i < end; ++i) {
+          buffer[cursors[bucket_of(first[i])]++] = std::move(first[i]);
+        }
+      });
+  parallel::for_each_range(
+      n, threads, [&](std::size_t begin, std::size_t end, std::size_t) {
+        std::move(buffer.begin() + begin, buffer.begin() + end, first + begin);
+      });
+  parallel::for_each_range(
+      splitters.size() + 1, threads,
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {  // bucket 2i, unequal ones
+          intro_sort(first + bounds[2 * i], first + bounds[2 * i + 1], pred);
+        }
+      });
+}
 
-    value_type value = first[i];
-    difference_type j = 0, next_j = 0;
-    for (j = i; iters[j] != first + i; j = next_j) {  // circle move
-      next_j = iters[j] - first;
-      first[j] = *iters[j];
-      iters[j] = first + j;
+template <typename RandomAccessIterator>
+void parallel_sort(RandomAccessIterator first, RandomAccessIterator last) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  parallel_sort(first, last, std::less<value_type>());
+}
+
+// fill [index, index + n) with the permutation that sorts keys key(0), ...,
+// key(n-1) by pred, that is key(index[0]), key(index[1]), ... are sorted.
+// equal keys keep their order. no memory allocated besides recursion.
+// remarks: a compact index type such as std::uint32_t halves memory traffic
+//  against iterators, std::length_error is thrown if it cannot hold n.
+template <typename IndexIterator, typename KeyFunction,
+          typename BinaryPredicate>
+void sort_permutation(std::size_t n, IndexIterator index, KeyFunction key,
+                      BinaryPredicate pred) {
+  typedef typename std::iterator_traits<IndexIterator>::value_type index_type;
+  if (n > 0 && std::size_t(std::numeric_limits<index_type>::max()) < n - 1) {
+    throw std::length_error("sort_permutation: index type too small");
+  }
+  for (std::size_t i = 0; i < n; ++i) index[i] = static_cast<index_type>(i);
+  intro_sort(index, index + n,
+             [&key, &pred](index_type lhs, index_type rhs) {
+               if (pred(key(lhs), key(rhs))) return true;
+               return !pred(key(rhs), key(lhs)) && lhs < rhs;
+             });
+}
+
+// fill [index, index + (last-first)) with the permutation that sorts
+// [first, last) by pred
+template <typename RandomAccessIterator, typename IndexIterator,
+          typename BinaryPredicate>
+void sort_permutation(RandomAccessIterator first, RandomAccessIterator last,
+                      IndexIterator index, BinaryPredicate pred) {
+  sort_permutation(
+      last - first, index,
+      [first](std::size_t i) -> decltype(first[i]) { return first[i]; }, pred);
+}
+
+template <typename RandomAccessIterator, typename IndexIterator>
+void sort_permutation(RandomAccessIterator first, RandomAccessIterator last,
+                      IndexIterator index) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  sort_permutation(first, last, index, std::less<value_type>());
+}
+
+namespace internal {
+
+template <typename Tuple, typename... RandomAccessIterators,
+          std::size_t... Is>
+void assign_at(std::size_t i, Tuple& values, std::index_sequence<Is...>,
+               RandomAccessIterators... arrays) {
+  ((arrays[i] = std::move(std::get<Is>(values))), ...);
+}
+
+}  // namespace internal
+
+// rearrange every array so that arrays[i] becomes the old arrays[index[i]],
+// for a permutation [index_first, index_last), such as one made by
+// sort_permutation(). so columns of a structure of arrays are sorted together
+// by one permutation, each element moved once along the permutation cycles.
+// post-condition: [index_first, index_last) is the identity permutation
+template <typename IndexIterator, typename... RandomAccessIterators>
+void apply_permutation(IndexIterator index_first, IndexIterator index_last,
+                       RandomAccessIterators... arrays) {
+  typedef typename std::iterator_traits<IndexIterator>::value_type index_type;
+  typedef std::tuple<
+      typename std::iterator_traits<RandomAccessIterators>::value_type...>
+      values_type;
+  const std::size_t n = index_last - index_first;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (std::size_t(index_first[i]) == i) {
+      continue;  // in place, or cycle done
+    }
+    values_type values(std::move(arrays[i])...);
+    std::size_t j = i;
+    for (std::size_t k = index_first[j]; k != i; k = index_first[j]) {
+      ((arrays[j] = std::move(arrays[k])), ...);
+      index_first[j] = static_cast<index_type>(j);
+      j = k;
     }
-    first[j] = value;
-    iters[j] = first + j;
+    internal::assign_at(j, values,
+                        std::index_sequence_for<RandomAccessIterators...>(),
+                        arrays...);
+    index_first[j] = static_cast<index_type>(j);
   }
 }
 
+// sort [first, last) by moving each element once, through a permutation of
+// indices, suits elements expensive to swap
+template <typename RandomAccessIterator, typename BinaryPredicate>
+void indirect_sort(RandomAccessIterator first, RandomAccessIterator last,
+                   BinaryPredicate pred) {
+  std::vector<std::size_t> index(last - first);
+  sort_permutation(first, last, index.begin(), pred);
+  apply_permutation(index.begin(), index.end(), first);
+}
+
 template <typename RandomAccessIterator>
 void indirect_sort(RandomAccessIterator first, RandomAccessIterator last) {
   typedef typename std::iterator_traits<RandomAccessIterator>::value_type
@@ -381,6 +921,546 @@ ForwardIterator bucket_sort(ForwardIterator first, ForwardIterator last,
   return first;
 }
 
+// radix sort
+// =============================================================================
+
+// map /key/ to an unsigned integer of the same width with the same order:
+// signed integers get their sign bit flipped, floating points get all bits
+// flipped if negative, or the sign bit flipped otherwise.
+// remarks: -0.0 orders before +0.0, NaNs with sign bit clear after +inf.
+template <typename Key>
+typename std::enable_if<std::is_integral<Key>::value,
+                        typename std::make_unsigned<Key>::type>::type
+radix_key(Key key) {
+  typedef typename std::make_unsigned<Key>::type ordered_type;
+  const ordered_type sign_bit = std::is_signed<Key>::value
+                                    ? ordered_type(1) << (8 * sizeof(Key) - 1)
+                                    : 0;
+  return static_cast<ordered_type>(key) ^ sign_bit;
+}
+
+inline std::uint32_t radix_key(float key) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &key, sizeof(bits));
+  return bits ^ (bits >> 31 ? 0xffffffffu : 0x80000000u);
+}
+
+inline std::uint64_t radix_key(double key) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &key, sizeof(bits));
+  return bits ^ (bits >> 63 ? ~std::uint64_t(0) : std::uint64_t(1) << 63);
+}
+
+namespace internal {
+
+enum {
+  MSD_RADIX_SORT_CUTOFF = 64,  // buckets smaller use comparison sort
+};
+
+// key extractor of whole values
+struct IdentityKey {
+  template <typename T>
+  const T& operator()(const T& value) const {
+    return value;
+  }
+};
+
+// ordered integer type of keys extracted by KeyExtractor from Iterator
+template <typename Iterator, typename KeyExtractor>
+struct radix_key_type {
+  typedef typename std::decay<decltype(sorting::radix_key(
+      std::declval<KeyExtractor&>()(*std::declval<Iterator&>())))>::type type;
+};
+
+// scratch space of radix sorts
+template <typename Iterator>
+struct radix_buffer {
+  typedef std::vector<typename std::iterator_traits<Iterator>::value_type> type;
+};
+
+// digits of Bits bits in keys of Ordered
+template <unsigned Bits, typename Ordered>
+struct radix_digits {
+  static_assert(0 < Bits && Bits <= 16, "radix_sort: 1 to 16 bits per digit");
+  static const std::size_t radix = std::size_t(1) << Bits;
+  static const std::size_t mask = radix - 1;
+  static const unsigned passes = (8 * sizeof(Ordered) + Bits - 1) / Bits;
+};
+
+// move [first, last) to /result/ by digit at /shift/, /offsets/ is the
+// position of the first element of each digit, advanced while moving
+template <typename RandomAccessIterator1, typename RandomAccessIterator2,
+          typename KeyExtractor>
+void radix_scatter(RandomAccessIterator1 first, RandomAccessIterator1 last,
+                   RandomAccessIterator2 result, unsigned shift,
+                   std::size_t mask, std::size_t* offsets, KeyExtractor& key) {
+  for (; first != last; ++first) {
+    std::size_t digit = (sorting::radix_key(key(*first)) >> shift) & mask;
+    result[offsets[digit]++] = std::move(*first);
+  }
+}
+
+template <unsigned Bits, typename RandomAccessIterator, typename KeyExtractor>
+void msd_radix_sort(RandomAccessIterator first, RandomAccessIterator last,
+                    unsigned shift, KeyExtractor& key) {
+  typedef typename radix_key_type<RandomAccessIterator, KeyExtractor>::type
+      ordered_type;
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  typedef radix_digits<Bits, ordered_type> digits;
+  if (last - first <= MSD_RADIX_SORT_CUTOFF) {
+    sorting::intro_sort(first, last,
+                        [&key](const value_type& lhs, const value_type& rhs) {
+                          return sorting::radix_key(key(lhs)) <
+                                 sorting::radix_key(key(rhs));
+                        });
+    return;
+  }
+  auto digit_of = [&key, shift](const value_type& value) {
+    return (sorting::radix_key(key(value)) >> shift) & digits::mask;
+  };
+
+  std::size_t heads[digits::radix] = {}, tails[digits::radix];
+  for (RandomAccessIterator iter = first; iter != last; ++iter) {
+    ++heads[digit_of(*iter)];
+  }
+  for (std::size_t d = 0, offset = 0; d < digits::radix; ++d) {
+    std::size_t count = heads[d];
+    heads[d] = offset;
+    tails[d] = offset += count;
+  }
+
+  // american flag: cycle each misplaced element to the head of its bucket
+  for (std::size_t d = 0; d < digits::radix; ++d) {
+    while (heads[d] < tails[d]) {
+      std::size_t target = digit_of(first[heads[d]]);
+      if (target == d) {
+        ++heads[d];
+      } else {
+        std::iter_swap(first + heads[d], first + heads[target]++);
+      }
+    }
+  }
+
+  if (0 == shift) {
+    return;
+  }
+  unsigned next_shift = shift > Bits ? shift - Bits : 0;
+  for (std::size_t d = 0, begin = 0; d < digits::radix; ++d) {
+    if (tails[d] - begin > 1) {
+      msd_radix_sort<Bits>(first + begin, first + tails[d], next_shift, key);
+    }
+    begin = tails[d];
+  }
+}
+
+}  // namespace internal
+
+// stable LSD radix sort of [first, last) by key(value), which is integral or
+// floating point, with digits of Bits bits. /buffer/ is grown to (last-first)
+// elements as scratch space and may be reused across calls.
+// remarks: histograms of all digits are taken in one read, passes whose digit
+//  is the same for every key are skipped.
+template <unsigned Bits = 8, typename RandomAccessIterator,
+          typename KeyExtractor>
+void radix_sort(
+    RandomAccessIterator first, RandomAccessIterator last,
+    typename internal::radix_buffer<RandomAccessIterator>::type& buffer,
+    KeyExtractor key) {
+  typedef typename internal::radix_key_type<RandomAccessIterator,
+                                            KeyExtractor>::type ordered_type;
+  typedef internal::radix_digits<Bits, ordered_type> digits;
+  const std::size_t n = last - first;
+  if (n <= 1) {
+    return;
+  }
+  if (buffer.size() < n) {
+    buffer.resize(n);
+  }
+
+  std::vector<std::size_t> counts(digits::passes * digits::radix, 0);
+  for (RandomAccessIterator iter = first; iter != last; ++iter) {
+    ordered_type k = sorting::radix_key(key(*iter));
+    for (unsigned p = 0; p < digits::passes; ++p) {
+      ++counts[p * digits::radix + ((k >> (p * Bits)) & digits::mask)];
+    }
+  }
+
+  const ordered_type some_key = sorting::radix_key(key(*first));
+  bool in_buffer = false;
+  for (unsigned p = 0; p < digits::passes; ++p) {
+    std::size_t* offsets = &counts[p * digits::radix];
+    if (offsets[(some_key >> (p * Bits)) & digits::mask] == n) {
+      continue;  // all keys share this digit
+    }
+    for (std::size_t d = 0, offset = 0; d < digits::radix; ++d) {
+      std::size_t count = offsets[d];
+      offsets[d] = offset;
+      offset += count;
+    }
+    if (in_buffer) {
+      internal::radix_scatter(buffer.begin(), buffer.begin() + n, first,
+                              p * Bits, digits::mask, offsets, key);
+    } else {
+      internal::radix_scatter(first, last, buffer.begin(), p * Bits,
+                              digits::mask, offsets, key);
+    }
+    in_buffer = !in_buffer;
+  }
+  if (in_buffer) {
+    std::move(buffer.begin(), buffer.begin() + n, first);
+  }
+}
+
+template <unsigned Bits = 8, typename RandomAccessIterator,
+          typename KeyExtractor>
+void radix_sort(RandomAccessIterator first, RandomAccessIterator last,
+                KeyExtractor key) {
+  typename internal::radix_buffer<RandomAccessIterator>::type buffer;
+  radix_sort<Bits>(first, last, buffer, key);
+}
+
+template <unsigned Bits = 8, typename RandomAccessIterator>
+void radix_sort(RandomAccessIterator first, RandomAccessIterator last) {
+  radix_sort<Bits>(first, last, internal::IdentityKey());
+}
+
+// in-place MSD radix sort of [first, last) by key(value), digits of Bits
+// bits from the most significant, small buckets are intro sorted. not stable.
+template <unsigned Bits = 8, typename RandomAccessIterator,
+          typename KeyExtractor>
+void msd_radix_sort(RandomAccessIterator first, RandomAccessIterator last,
+                    KeyExtractor key) {
+  typedef typename internal::radix_key_type<RandomAccessIterator,
+                                            KeyExtractor>::type ordered_type;
+  static_assert(Bits <= 11, "msd_radix_sort: at most 11 bits per digit");
+  const unsigned width = 8 * sizeof(ordered_type);
+  internal::msd_radix_sort<Bits>(first, last, width > Bits ? width - Bits : 0,
+                                 key);
+}
+
+template <unsigned Bits = 8, typename RandomAccessIterator>
+void msd_radix_sort(RandomAccessIterator first, RandomAccessIterator last) {
+  msd_radix_sort<Bits>(first, last, internal::IdentityKey());
+}
+
+// stable LSD radix sort like radix_sort() on /thread_count/ threads, 0 means
+// hardware concurrency. each pass counts digits per thread range, then every
+// thread moves its range to offsets after those of preceding ranges.
+template <unsigned Bits = 8, typename RandomAccessIterator,
+          typename KeyExtractor>
+void parallel_radix_sort(
+    RandomAccessIterator first, RandomAccessIterator last,
+    typename internal::radix_buffer<RandomAccessIterator>::type& buffer,
+    KeyExtractor key, std::size_t thread_count = 0) {
+  typedef typename internal::radix_key_type<RandomAccessIterator,
+                                            KeyExtractor>::type ordered_type;
+  typedef internal::radix_digits<Bits, ordered_type> digits;
+  const std::size_t n = last - first;
+  const std::size_t threads = parallel::thread_count(
+      thread_count, std::max<std::size_t>(n / internal::MIN_SORT_CHUNK, 1));
+  if (threads <= 1) {
+    radix_sort<Bits>(first, last, buffer, key);
+    return;
+  }
+  if (buffer.size() < n) {
+    buffer.resize(n);
+  }
+
+  // counts[t * radix + d]: digit d in range t, turned into offsets
+  std::vector<std::size_t> counts(threads * digits::radix);
+  bool in_buffer = false;
+  for (unsigned p = 0; p < digits::passes; ++p) {
+    const unsigned shift = p * Bits;
+    std::fill(counts.begin(), counts.end(), 0);
+    auto count_digits = [&](std::size_t begin, std::size_t end,
+                            std::size_t t) {
+      std::size_t* count = &counts[t * digits::radix];
+      for (std::size_t i = begin; i < end; ++i) {
+        ordered_type k = sorting::radix_key(
+            key(in_buffer ? buffer[i] : *(first + i)));
+        ++count[(k >> shift) & digits::mask];
+      }
+    };
+    parallel::for_each_range(n, threads, count_digits);
+
+    std::size_t offset = 0, largest = 0;
+    for (std::size_t d = 0; d < digits::radix; ++d) {
+      std::size_t total = 0;
+      for (std::size_t t = 0; t < threads; ++t) {
+        std::size_t count = counts[t * digits::radix + d];
+        counts[t * digits::radix + d] = offset;
+        offset += count;
+        total += count;
+      }
+      largest = std::max(largest, total);
+    }
+    if (largest == n) {
+      continue;  // all keys share this digit
+    }
+
+    parallel::for_each_range(
+        n, threads, [&](std::size_t begin, std::size_t end, std::size_t t) {
+          std::size_t* offsets = &counts[t * digits::radix];
+          if (in_buffer) {
+            internal::radix_scatter(buffer.begin() + begin,
+                                    buffer.begin() + end, first, shift,
+                                    digits::mask, offsets, key);
+          } else {
+            internal::radix_scatter(first + begin, first + end,
+                                    buffer.begin(), shift, digits::mask,
+                                    offsets, key);
+          }
+        });
+    in_buffer = !in_buffer;
+  }
+  if (in_buffer) {
+    std::move(buffer.begin(), buffer.begin() + n, first);
+  }
+}
+
+template <unsigned Bits = 8, typename RandomAccessIterator,
+          typename KeyExtractor>
+void parallel_radix_sort(RandomAccessIterator first,
+                         RandomAccessIterator last, KeyExtractor key,
+                         std::size_t thread_count = 0) {
+  typename internal::radix_buffer<RandomAccessIterator>::type buffer;
+  parallel_radix_sort<Bits>(first, last, buffer, key, thread_count);
+}
+
+template <unsigned Bits = 8, typename RandomAccessIterator>
+void parallel_radix_sort(RandomAccessIterator first,
+                         RandomAccessIterator last) {
+  parallel_radix_sort<Bits>(first, last, internal::IdentityKey());
+}
+
+// external sort
+// =============================================================================
+
+struct ExternalSortOptions {
+  std::size_t memory_budget = std::size_t(256) << 20;  // bytes of records
+  std::size_t buffer_size = std::size_t(1) << 20;  // bytes per file buffer
+  std::size_t fan_in = 64;     // runs merged at once, at least 2
+  std::string temp_directory;  // empty means system temporary directory
+};
+
+namespace internal {
+
+// temporary file removed on destruction
+class TempFile {
+ public:
+  explicit TempFile(const std::string& directory) {
+    static std::atomic<unsigned long> counter(0);
+    std::filesystem::path base = directory.empty()
+                                     ? std::filesystem::temp_directory_path()
+                                     : std::filesystem::path(directory);
+    path_ = base / ("external_sort-" + std::to_string(std::random_device()()) +
+                    "-" + std::to_string(counter++));
+  }
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  ~TempFile() {
+    std::error_code ignored;
+    std::filesystem::remove(path_, ignored);
+  }
+
+  const std::filesystem::path& path() const { return path_; }
+
+ private:
+  std::filesystem::path path_;
+};
+
+// records of runs, raw bytes if trivially copyable, text otherwise
+template <typename T, bool Raw = std::is_trivially_copyable<T>::value>
+struct RunFormat {
+  static bool read(std::istream& is, T& record) {
+    return static_cast<bool>(
+        is.read(reinterpret_cast<char*>(&record), sizeof(T)));
+  }
+  static void write(std::ostream& os, const T& record) {
+    os.write(reinterpret_cast<const char*>(&record), sizeof(T));
+  }
+};
+
+template <typename T>
+struct RunFormat<T, false> {
+  static bool read(std::istream& is, T& record) {
+    return static_cast<bool>(is >> record);
+  }
+  static void write(std::ostream& os, const T& record) { os << record << '\n'; }
+};
+
+// file stream with a buffer of /buffer_size/ bytes
+template <typename FileStream>
+class BufferedFile {
+ public:
+  BufferedFile(const std::filesystem::path& path, std::size_t buffer_size,
+               std::ios_base::openmode mode)
+      : buffer_(std::max<std::size_t>(buffer_size, 1)) {
+    stream_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+    stream_.open(path, mode | std::ios_base::binary);
+    if (!stream_) {
+      throw std::runtime_error("external_sort: cannot open " + path.string());
+    }
+  }
+
+  FileStream& stream() { return stream_; }
+
+ private:
+  std::vector<char> buffer_;
+  FileStream stream_;
+};
+
+// k-way merge of sorted sources by a tree of losers: every internal node
+// keeps the source which lost the match there, so replacing the winner
+// replays only its path to the root, log2(k) comparisons per record.
+// remarks: ties go to the source of lower index, which keeps merge stable.
+template <typename T, typename BinaryPredicate>
+class LoserTree {
+ public:
+  // /read(i, record)/ gets next record of source i, false if exhausted
+  template <typename Reader>
+  LoserTree(std::size_t k, Reader read, BinaryPredicate pred)
+      : records_(k), alive_(k), losers_(std::max<std::size_t>(k, 1)),
+        pred_(pred) {
+    for (std::size_t i = 0; i < k; ++i) alive_[i] = read(i, records_[i]);
+    std::vector<std::size_t> winners(2 * k);
+    for (std::size_t i = 0; i < k; ++i) winners[k + i] = i;
+    for (std::size_t n = k - 1; n > 0; --n) {
+      std::size_t lhs = winners[2 * n], rhs = winners[2 * n + 1];
+      bool left_wins = less(lhs, rhs);
+      winners[n] = left_wins ? lhs : rhs;
+      losers_[n] = left_wins ? rhs : lhs;
+    }
+    losers_[0] = k > 1 ? winners[1] : 0;
+  }
+
+  bool empty() const { return records_.empty() || !alive_[losers_[0]]; }
+  std::size_t winner() const { return losers_[0]; }
+  T& top() { return records_[losers_[0]]; }
+
+  // refill the winner from its source, then find the next winner
+  template <typename Reader>
+  void replace(Reader read) {
+    std::size_t winner = losers_[0], k = records_.size();
+    alive_[winner] = read(winner, records_[winner]);
+    for (std::size_t n = (winner + k) / 2; n > 0; n /= 2) {
+      if (less(losers_[n], winner)) std::swap(losers_[n], winner);
+    }
+    losers_[0] = winner;
+  }
+
+ private:
+  bool less(std::size_t lhs, std::size_t rhs) const {
+    if (!alive_[lhs] || !alive_[rhs]) return alive_[lhs] && !alive_[rhs];
+    if (pred_(records_[lhs], records_[rhs])) return true;
+    return !pred_(records_[rhs], records_[lhs]) && lhs < rhs;
+  }
+
+  std::vector<T> records_;
+  std::vector<char> alive_;
+  std::vector<std::size_t> losers_;  // losers_[0] is overall winner
+  BinaryPredicate pred_;
+};
+
+// merge runs [first, last) into /os/ with write(os, record)
+template <typename T, typename BinaryPredicate, typename Writer>
+void merge_runs(const std::vector<std::unique_ptr<TempFile> >& runs,
+                std::size_t first, std::size_t last, std::ostream& os,
+                Writer write, BinaryPredicate pred,
+                const ExternalSortOptions& options) {
+  std::vector<std::unique_ptr<BufferedFile<std::ifstream> > > files;
+  for (std::size_t i = first; i < last; ++i) {
+    files.emplace_back(new BufferedFile<std::ifstream>(
+        runs[i]->path(), options.buffer_size, std::ios_base::in));
+  }
+  auto read = [&files](std::size_t i, T& record) {
+    return RunFormat<T>::read(files[i]->stream(), record);
+  };
+  LoserTree<T, BinaryPredicate> tree(files.size(), read, pred);
+  for (; !tree.empty(); tree.replace(read)) write(os, tree.top());
+}
+
+}  // namespace internal
+
+// sort records of type T read by operator>> from /is/ until it fails, and
+// write them by operator<< to /os/, one per line, return number of records.
+// runs of at most options.memory_budget bytes are stable sorted in memory and
+// saved in temporary files, then merged options.fan_in at a time with a tree
+// of losers, so the sort is stable as a whole.
+// remarks: sizeof(T) is taken as size of a record, heap memory owned by
+//  records is not counted. trivially copyable records are saved as raw bytes
+//  in runs.
+template <typename T, typename BinaryPredicate>
+std::size_t external_sort(
+    std::istream& is, std::ostream& os, BinaryPredicate pred,
+    const ExternalSortOptions& options = ExternalSortOptions()) {
+  typedef std::unique_ptr<internal::TempFile> run_type;
+  const std::size_t capacity =
+      std::max<std::size_t>(options.memory_budget / sizeof(T), 1);
+  const std::size_t fan_in = std::max<std::size_t>(options.fan_in, 2);
+  auto write_text = [](std::ostream& out, const T& record) {
+    out << record << '\n';
+  };
+
+  // sorted runs
+  std::vector<run_type> runs;
+  std::vector<T> records;
+  std::size_t total = 0;
+  T record;
+  for (bool more = true; more;) {
+    records.clear();
+    while (records.size() < capacity &&
+           (more = static_cast<bool>(is >> record))) {
+      records.push_back(std::move(record));
+    }
+    total += records.size();
+    std::stable_sort(records.begin(), records.end(), pred);
+    if (runs.empty() && !more) {  // fits in memory
+      for (const T& sorted : records) write_text(os, sorted);
+      return total;
+    }
+    if (records.empty()) break;
+    runs.emplace_back(new internal::TempFile(options.temp_directory));
+    internal::BufferedFile<std::ofstream> file(
+        runs.back()->path(), options.buffer_size, std::ios_base::out);
+    for (const T& sorted : records) {
+      internal::RunFormat<T>::write(file.stream(), sorted);
+    }
+    if (!file.stream().flush()) {
+      throw std::runtime_error("external_sort: cannot write run");
+    }
+  }
+  std::vector<T>().swap(records);
+
+  // merge passes until fan_in runs at most remain
+  while (runs.size() > fan_in) {
+    std::vector<run_type> merged;
+    for (std::size_t first = 0; first < runs.size(); first += fan_in) {
+      std::size_t last = std::min(first + fan_in, runs.size());
+      merged.emplace_back(new internal::TempFile(options.temp_directory));
+      internal::BufferedFile<std::ofstream> file(
+          merged.back()->path(), options.buffer_size, std::ios_base::out);
+      internal::merge_runs<T>(runs, first, last, file.stream(),
+                              internal::RunFormat<T>::write, pred, options);
+      if (!file.stream().flush()) {
+        throw std::runtime_error("external_sort: cannot write run");
+      }
+    }
+    runs.swap(merged);
+  }
+  internal::merge_runs<T>(runs, 0, runs.size(), os, write_text, pred,
+                          options);
+  return total;
+}
+
+template <typename T>
+std::size_t external_sort(
+    std::istream& is, std::ostream& os,
+    const ExternalSortOptions& options = ExternalSortOptions()) {
+  return external_sort<T>(is, os, std::less<T>(), options);
+}
+
 template <typename RandomAccessIterator, typename Distance,
           typename BinaryPredicate>
 RandomAccessIterator quick_select(RandomAccessIterator first,
@@ -449,6 +1529,180 @@ RandomAccessIterator heap_select(RandomAccessIterator first,
   return heap_select(first, last, n, std::less<value_type>());
 }
 
+// =============================================================================
+// top-k selection: the k first values of a range in pred order, that is the k
+// smallest for std::less and the k largest for std::greater.
+// remarks: when pred is not a strict total order, which of the equal values
+//  at the k-th place are kept depends on input order and thread count.
+
+// streaming top-k accumulator, values are pushed one by one while parsed
+// remarks: bounded heap of at most k values with the last one in pred order
+//  on top, a push costs O(1) when the value does not enter and O(log k)
+//  otherwise. accumulators filled on different threads are combined by
+//  merge().
+template <typename T, typename BinaryPredicate = std::less<T> >
+class TopK {
+ public:
+  explicit TopK(std::size_t k, BinaryPredicate pred = BinaryPredicate())
+      : k_(k), pred_(pred) {}
+
+  void push(const T& value) {
+    if (heap_.size() < k_) {
+      heap_.push_back(value);
+      tree::heap::push(heap_.begin(), heap_.end(), pred_);
+    } else if (k_ > 0 && pred_(value, heap_.front())) {
+      heap_.front() = value;
+      tree::heap::percolate_down(heap_.begin(), heap_.end(), 0, pred_);
+    }
+  }
+
+  // push all values of other, other is left unchanged
+  void merge(const TopK& other) {
+    for (const T& value : other.heap_) push(value);
+  }
+
+  // kept values in pred order, the accumulator is left empty
+  std::vector<T> release() {
+    std::vector<T> values;
+    values.swap(heap_);
+    heap_sort(values.begin(), values.end(), pred_);
+    return values;
+  }
+
+  void clear() { heap_.clear(); }
+  std::size_t k() const { return k_; }
+  std::size_t size() const { return heap_.size(); }
+  bool empty() const { return heap_.empty(); }
+
+ private:
+  std::size_t k_;
+  BinaryPredicate pred_;
+  std::vector<T> heap_;
+};
+
+// streaming top-k per group, e.g. per row or column of a matrix
+// remarks: groups are indexed 0, 1, ... and created on first push, so memory
+//  is O(groups * k).
+template <typename T, typename BinaryPredicate = std::less<T> >
+class GroupedTopK {
+ public:
+  explicit GroupedTopK(std::size_t k, BinaryPredicate pred = BinaryPredicate())
+      : k_(k), pred_(pred) {}
+
+  void push(std::size_t group, const T& value) {
+    while (groups_.size() <= group) groups_.emplace_back(k_, pred_);
+    groups_[group].push(value);
+  }
+
+  void merge(const GroupedTopK& other) {
+    while (groups_.size() < other.groups_.size()) {
+      groups_.emplace_back(k_, pred_);
+    }
+    for (std::size_t g = 0; g < other.groups_.size(); ++g) {
+      groups_[g].merge(other.groups_[g]);
+    }
+  }
+
+  // kept values of every group in pred order, the accumulator is left empty
+  std::vector<std::vector<T> > release() {
+    std::vector<std::vector<T> > values(groups_.size());
+    for (std::size_t g = 0; g < groups_.size(); ++g) {
+      values[g] = groups_[g].release();
+    }
+    groups_.clear();
+    return values;
+  }
+
+  const TopK<T, BinaryPredicate>& group(std::size_t g) const {
+    return groups_[g];
+  }
+
+  void clear() { groups_.clear(); }
+  std::size_t k() const { return k_; }
+  std::size_t group_count() const { return groups_.size(); }
+
+ private:
+  std::size_t k_;
+  BinaryPredicate pred_;
+  std::vector<TopK<T, BinaryPredicate> > groups_;
+};
+
+// the min(k, last-first) first values of [first, last) in pred order, found
+// on /thread_count/ threads (0 means hardware concurrency)
+// remarks: each thread keeps a TopK over its chunk, chunks are then merged.
+//  O(n log k / threads + threads * k log k), [first, last) is not modified.
+template <typename RandomAccessIterator, typename BinaryPredicate>
+std::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>
+parallel_top_k(RandomAccessIterator first, RandomAccessIterator last,
+               std::size_t k, BinaryPredicate pred,
+               std::size_t thread_count = 0) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  const std::size_t n = last - first;
+  const std::size_t threads = parallel::thread_count(
+      thread_count, std::max<std::size_t>(n / internal::MIN_SORT_CHUNK, 1));
+  std::vector<TopK<value_type, BinaryPredicate> > partial(
+      threads, TopK<value_type, BinaryPredicate>(k, pred));
+  parallel::for_each_range(
+      n, threads, [&](std::size_t begin, std::size_t end, std::size_t t) {
+        for (std::size_t i = begin; i < end; ++i) partial[t].push(first[i]);
+      });
+  for (std::size_t t = 1; t < threads; ++t) partial[0].merge(partial[t]);
+  return partial[0].release();
+}
+
+template <typename RandomAccessIterator>
+std::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>
+parallel_top_k(RandomAccessIterator first, RandomAccessIterator last,
+               std::size_t k) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  return parallel_top_k(first, last, k, std::less<value_type>());
+}
+
+// top-k of [first, last) per group(value) on /thread_count/ threads, result
+// g holds the values of group g in pred order
+// remarks: each thread keeps a GroupedTopK over its chunk, then groups are
+//  split among threads to merge the chunks.
+template <typename RandomAccessIterator, typename GroupFunction,
+          typename BinaryPredicate>
+std::vector<std::vector<
+    typename std::iterator_traits<RandomAccessIterator>::value_type> >
+parallel_grouped_top_k(RandomAccessIterator first, RandomAccessIterator last,
+                       std::size_t k, GroupFunction group, BinaryPredicate pred,
+                       std::size_t thread_count = 0) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  const std::size_t n = last - first;
+  const std::size_t threads = parallel::thread_count(
+      thread_count, std::max<std::size_t>(n / internal::MIN_SORT_CHUNK, 1));
+  std::vector<GroupedTopK<value_type, BinaryPredicate> > partial(
+      threads, GroupedTopK<value_type, BinaryPredicate>(k, pred));
+  parallel::for_each_range(
+      n, threads, [&](std::size_t begin, std::size_t end, std::size_t t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          partial[t].push(group(first[i]), first[i]);
+        }
+      });
+  std::size_t group_count = 0;
+  for (std::size_t t = 0; t < threads; ++t) {
+    group_count = std::max(group_count, partial[t].group_count());
+  }
+  std::vector<std::vector<value_type> > values(group_count);
+  parallel::for_each_range(
+      group_count, threads,
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t g = begin; g < end; ++g) {
+          TopK<value_type, BinaryPredicate> merged(k, pred);
+          for (std::size_t t = 0; t < threads; ++t) {
+            if (g < partial[t].group_count()) merged.merge(partial[t].group(g));
+          }
+          values[g] = merged.release();
+        }
+      });
+  return values;
+}
+
 }  // namespace sorting
 
 #endif  // SORTING_H_
@@ -0,0 +1,150 @@
+// Compares sorting::parallel_sort and radix sorts against sorting::intro_sort
+// and std::sort, then sort_small against insertion_sort on small groups.
+// usage: sorting_benchmark [key-count [thread-count]], 10^8 keys by default.
+// build with -DWITH_PARALLEL_STL and link TBB (-ltbb with libstdc++) to add
+// std::sort(std::execution::par, ...).
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(WITH_PARALLEL_STL)
+#include <execution>
+#endif
+
+#include "sorting/sorting.h"
+#include "timing/timing.h"
+
+namespace {
+
+typedef std::uint64_t key_type;
+
+std::vector<key_type> make_keys(std::size_t n, const std::string& shape) {
+  std::vector<key_type> keys(n);
+  std::mt19937_64 rng(2024);
+  for (std::size_t i = 0; i < n; ++i) {
+    if ("random" == shape) {
+      keys[i] = rng();
+    } else if ("few" == shape) {
+      keys[i] = rng() % 16;
+    } else {  // "sorted" with 1% perturbation
+      keys[i] = rng() % 100 == 0 ? rng() : i;
+    }
+  }
+  return keys;
+}
+
+// seconds taken by sort on a copy of keys, checked afterwards
+template <typename Function>
+double measure(const std::vector<key_type>& keys, Function sort) {
+  std::vector<key_type> copy(keys);
+  timing::Timer timer;
+  timer.start();
+  sort(copy.begin(), copy.end());
+  timer.stop();
+  if (!std::is_sorted(copy.begin(), copy.end())) {
+    std::cerr << "not sorted" << std::endl;
+    std::exit(1);
+  }
+  return timer.duration();
+}
+
+// seconds taken by sort on every group of /group/ keys of a copy of keys
+template <typename T, typename Function>
+double measure_groups(const std::vector<T>& keys, std::size_t group,
+                      Function sort) {
+  std::vector<T> copy(keys);
+  timing::Timer timer;
+  timer.start();
+  for (std::size_t i = 0; i + group <= copy.size(); i += group) {
+    sort(copy.begin() + i, copy.begin() + i + group);
+  }
+  timer.stop();
+  return timer.duration();
+}
+
+// sort_small, insertion_sort and std::sort on groups of 8 to 64 keys
+template <typename T>
+void benchmark_small(const char* type_name, std::size_t n) {
+  typedef typename std::vector<T>::iterator iterator;
+  std::vector<T> keys(n);
+  std::mt19937_64 rng(2024);
+  for (auto& key : keys) key = static_cast<T>(rng() % 1000000);
+  for (std::size_t group : {8, 16, 32, 64}) {
+    double network = measure_groups(keys, group, [](iterator f, iterator l) {
+      sorting::sort_small(f, l);
+    });
+    double insertion = measure_groups(keys, group, [](iterator f, iterator l) {
+      sorting::insertion_sort(f, l);
+    });
+    double standard = measure_groups(
+        keys, group, [](iterator f, iterator l) { std::sort(f, l); });
+    std::cout << std::setw(8) << type_name << std::setw(8) << group
+              << std::setw(14) << network << std::setw(14) << insertion
+              << std::setw(14) << standard << std::endl;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  typedef std::vector<key_type>::iterator iterator;
+  std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000000;
+  std::size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+
+  std::cout << "keys: " << n << ", threads: "
+            << parallel::thread_count(threads, n) << ", seconds" << std::endl;
+  std::cout << std::setw(8) << "shape" << std::setw(14) << "parallel"
+            << std::setw(14) << "intro_sort" << std::setw(14) << "radix"
+            << std::setw(14) << "par radix" << std::setw(14) << "std::sort"
+#if defined(WITH_PARALLEL_STL)
+            << std::setw(14) << "std par"
+#endif
+            << std::endl;
+  for (const char* shape : {"random", "few", "sorted"}) {
+    std::vector<key_type> keys = make_keys(n, shape);
+    double parallel = measure(keys, [threads](iterator first, iterator last) {
+      sorting::parallel_sort(first, last, std::less<key_type>(), threads);
+    });
+    double intro = measure(keys, [](iterator first, iterator last) {
+      sorting::intro_sort(first, last);
+    });
+    std::vector<key_type> buffer;
+    auto identity = [](key_type key) { return key; };
+    double radix =
+        measure(keys, [&buffer, &identity](iterator first, iterator last) {
+          sorting::radix_sort<11>(first, last, buffer, identity);
+        });
+    double parallel_radix =
+        measure(keys, [&](iterator first, iterator last) {
+          sorting::parallel_radix_sort<11>(first, last, buffer, identity,
+                                           threads);
+        });
+    double standard = measure(
+        keys, [](iterator first, iterator last) { std::sort(first, last); });
+    std::cout << std::fixed << std::setprecision(2) << std::setw(8) << shape
+              << std::setw(14) << parallel << std::setw(14) << intro
+              << std::setw(14) << radix << std::setw(14) << parallel_radix
+              << std::setw(14) << standard;
+#if defined(WITH_PARALLEL_STL)
+    std::cout << std::setw(14)
+              << measure(keys, [](iterator first, iterator last) {
+                   std::sort(std::execution::par, first, last);
+                 });
+#endif
+    std::cout << std::endl;
+  }
+
+  std::cout << std::setw(8) << "type" << std::setw(8) << "group"
+            << std::setw(14) << "sort_small" << std::setw(14) << "insertion"
+            << std::setw(14) << "std::sort" << std::endl;
+  benchmark_small<std::int32_t>("int32", std::min<std::size_t>(n, 1 << 24));
+  benchmark_small<double>("double", std::min<std::size_t>(n, 1 << 24));
+  return 0;
+}
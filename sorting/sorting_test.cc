@@ -1,10 +1,22 @@
 #include "sorting.h"
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -162,6 +174,361 @@ TEST_F(SortingTest, QuickSort) {
   }
 }
 
+TEST(QuickSortTest, LargeRandom) {
+  // a comparator without a network, so partition does all the work
+  auto greater = [](long a, long b) { return a > b; };
+  std::srand(2024);
+  for (int round = 0; round < 20; ++round) {
+    std::vector<long> seq(5000 + round);
+    for (auto& value : seq) value = std::rand() % 10000;
+    sorting::quick_sort(seq.begin(), seq.end(), greater);
+    EXPECT_TRUE(std::is_sorted(seq.begin(), seq.end(), greater)) << round;
+  }
+}
+
+TEST_F(SortingTest, IntroSort) {
+  std::vector<int> seq;
+  for (size_t t = 0; t < lengths_.size(); ++t) {
+    seq.assign(values_.begin(), values_.begin() + lengths_[t]);
+    sorting::intro_sort(seq.begin(), seq.end());
+    EXPECT_THAT(seq, ElementsAreArray(sorted_[t]));
+  }
+}
+
+TEST(IntroSortTest, Adversarial) {
+  const int n = 1 << 16;
+  std::vector<std::vector<int>> inputs(4);
+  for (int i = 0; i < n; ++i) {
+    inputs[0].push_back(i % 3);                   // few distinct keys
+    inputs[1].push_back(n - i);                   // descending
+    inputs[2].push_back(i % 2 ? i : n - i);       // organ pipe
+    inputs[3].push_back(i < n / 2 ? 2 * i : 2 * (i - n / 2) + 1);
+  }
+  for (auto& seq : inputs) {
+    std::vector<int> expected(seq);
+    std::sort(expected.begin(), expected.end());
+    sorting::intro_sort(seq.begin(), seq.end());
+    EXPECT_EQ(seq, expected);
+  }
+
+  // median3 killer: every pivot is the 2nd smallest, heap sort takes over
+  std::vector<int> seq(n);
+  for (int i = 0; i < n; ++i) seq[i] = i;
+  for (int i = 0; i + 2 < n; ++i) {
+    std::swap(seq[i + 1], seq[i + 1 + (n - i - 1) / 2]);
+  }
+  sorting::intro_sort(seq.begin(), seq.end(), std::greater<int>());
+  EXPECT_TRUE(std::is_sorted(seq.begin(), seq.end(), std::greater<int>()));
+}
+
+TEST_F(SortingTest, ParallelSort) {
+  std::vector<int> seq;
+  for (size_t t = 0; t < lengths_.size(); ++t) {
+    seq.assign(values_.begin(), values_.begin() + lengths_[t]);
+    sorting::parallel_sort(seq.begin(), seq.end());
+    EXPECT_THAT(seq, ElementsAreArray(sorted_[t]));
+  }
+}
+
+TEST(ParallelSortTest, MatchesStdSort) {
+  std::srand(5);
+  for (int modulo : {4, 1000, RAND_MAX}) {
+    std::vector<int> seq(1 << 19);
+    for (auto& value : seq) value = std::rand() % modulo;
+    for (std::size_t threads : {2, 3, 8}) {
+      std::vector<int> actual(seq), expected(seq);
+      sorting::parallel_sort(actual.begin(), actual.end(), std::greater<int>(),
+                             threads);
+      std::sort(expected.begin(), expected.end(), std::greater<int>());
+      EXPECT_EQ(actual, expected) << modulo << " " << threads;
+    }
+  }
+
+  std::vector<std::string> words(300000);
+  for (auto& word : words) word = std::to_string(std::rand());
+  std::vector<std::string> expected(words);
+  sorting::parallel_sort(words.data(), words.data() + words.size(),
+                         std::less<std::string>(), 4);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(words, expected);
+}
+
+TEST(ParallelSortTest, DuplicateKeys) {
+  // keys equal to a splitter are not sorted at all: an all-equal range costs
+  // two comparisons per element in each of the counting and moving passes,
+  // sorting it would take about log2(n)
+  const std::size_t n = 1 << 18;
+  std::atomic<std::size_t> comparisons(0);
+  auto less = [&comparisons](int lhs, int rhs) {
+    comparisons.fetch_add(1, std::memory_order_relaxed);
+    return lhs < rhs;
+  };
+  std::vector<int> seq(n, 7);
+  sorting::parallel_sort(seq.begin(), seq.end(), less, 4);
+  EXPECT_EQ(seq, std::vector<int>(n, 7));
+  EXPECT_LT(comparisons.load(), 5 * n);
+
+  std::srand(13);  // a few heavy keys among distinct ones
+  for (auto& value : seq) {
+    value = std::rand() % 4 ? std::rand() % 3 : std::rand();
+  }
+  std::vector<int> expected(seq);
+  std::sort(expected.begin(), expected.end());
+  sorting::parallel_sort(seq.begin(), seq.end(), less, 4);
+  EXPECT_EQ(seq, expected);
+}
+
+TEST_F(SortingTest, RadixSort) {
+  std::vector<int> seq;
+  for (size_t t = 0; t < lengths_.size(); ++t) {
+    seq.assign(values_.begin(), values_.begin() + lengths_[t]);
+    sorting::radix_sort(seq.begin(), seq.end());
+    EXPECT_THAT(seq, ElementsAreArray(sorted_[t]));
+    seq.assign(values_.begin(), values_.begin() + lengths_[t]);
+    sorting::msd_radix_sort(seq.begin(), seq.end());
+    EXPECT_THAT(seq, ElementsAreArray(sorted_[t]));
+    seq.assign(values_.begin(), values_.begin() + lengths_[t]);
+    sorting::parallel_radix_sort(seq.begin(), seq.end());
+    EXPECT_THAT(seq, ElementsAreArray(sorted_[t]));
+  }
+}
+
+TEST(RadixSortTest, RadixKey) {
+  std::vector<double> doubles = {-1e300, -2.5, -1e-300, -0.0, 0.0,
+                                 1e-300, 3.0,  1e300};
+  std::vector<float> floats = {-1e30f, -2.5f, -0.0f, 0.0f, 1e-30f, 1e30f};
+  std::vector<long long> longs = {LLONG_MIN, -1, 0, 1, LLONG_MAX};
+  for (size_t i = 1; i < doubles.size(); ++i) {
+    EXPECT_LT(sorting::radix_key(doubles[i - 1]),
+              sorting::radix_key(doubles[i]));
+  }
+  for (size_t i = 1; i < floats.size(); ++i) {
+    EXPECT_LT(sorting::radix_key(floats[i - 1]), sorting::radix_key(floats[i]));
+  }
+  for (size_t i = 1; i < longs.size(); ++i) {
+    EXPECT_LT(sorting::radix_key(longs[i - 1]), sorting::radix_key(longs[i]));
+  }
+}
+
+TEST(RadixSortTest, MatchesStableSort) {
+  struct Cell {
+    std::uint32_t row, column;
+    float value;
+  };
+  std::srand(19);
+  std::vector<Cell> cells(300000);
+  for (auto& cell : cells) {
+    cell.row = std::rand() % 1000;
+    cell.column = std::rand();
+    cell.value = (std::rand() % 2000 - 1000) / 8.0f;
+  }
+  auto by_value = [](const Cell& cell) { return cell.value; };
+  auto by_row = [](const Cell& cell) { return cell.row; };
+  auto by_cell = [](const Cell& cell) {
+    return std::uint64_t(cell.row) << 32 | cell.column;
+  };
+  auto same = [](const std::vector<Cell>& lhs, const std::vector<Cell>& rhs) {
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      if (lhs[i].row != rhs[i].row || lhs[i].column != rhs[i].column) {
+        return false;
+      }
+    }
+    return lhs.size() == rhs.size();
+  };
+
+  std::vector<Cell> expected(cells), buffer;
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Cell& lhs, const Cell& rhs) {
+                     return lhs.value < rhs.value;
+                   });
+  std::vector<Cell> actual(cells);
+  sorting::radix_sort(actual.begin(), actual.end(), buffer, by_value);
+  EXPECT_TRUE(same(actual, expected));
+  actual = cells;
+  sorting::parallel_radix_sort<11>(actual.begin(), actual.end(), buffer,
+                                   by_value, 3);
+  EXPECT_TRUE(same(actual, expected));
+
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Cell& lhs, const Cell& rhs) {
+                     return lhs.row < rhs.row;
+                   });
+  sorting::radix_sort<11>(actual.begin(), actual.end(), buffer, by_row);
+  EXPECT_TRUE(same(actual, expected));
+
+  std::sort(expected.begin(), expected.end(),
+            [&by_cell](const Cell& lhs, const Cell& rhs) {
+              return by_cell(lhs) < by_cell(rhs);
+            });
+  actual = cells;
+  sorting::msd_radix_sort<11>(actual.begin(), actual.end(), by_cell);
+  EXPECT_TRUE(same(actual, expected));
+  actual = cells;
+  sorting::parallel_radix_sort(actual.begin(), actual.end(), by_cell, 8);
+  EXPECT_TRUE(same(actual, expected));
+}
+
+TEST(ExternalSortTest, ItWorks) {
+  std::srand(23);
+  std::vector<int> values(10000);
+  for (auto& value : values) value = std::rand() % 5000 - 2500;
+  std::ostringstream input;
+  for (int value : values) input << value << ' ';
+  std::sort(values.begin(), values.end(), std::greater<int>());
+
+  ExternalSortOptions options;
+  for (std::size_t budget : {std::size_t(1) << 20, sizeof(int) * 100}) {
+    for (std::size_t fan_in : {2, 64}) {
+      options.memory_budget = budget;
+      options.fan_in = fan_in;
+      options.buffer_size = 4096;
+      std::istringstream is(input.str());
+      std::stringstream os;
+      EXPECT_EQ(sorting::external_sort<int>(is, os, std::greater<int>(),
+                                            options),
+                values.size());
+      std::vector<int> actual{std::istream_iterator<int>(os),
+                              std::istream_iterator<int>()};
+      EXPECT_EQ(actual, values) << budget << " " << fan_in;
+    }
+  }
+
+  std::istringstream empty;
+  std::ostringstream os;
+  EXPECT_EQ(sorting::external_sort<int>(empty, os), 0);
+  EXPECT_EQ(os.str(), "");
+}
+
+// record which is not trivially copyable, saved as text in runs
+struct Record : std::pair<int, std::string> {
+  friend std::istream& operator>>(std::istream& is, Record& record) {
+    return is >> record.first >> record.second;
+  }
+  friend std::ostream& operator<<(std::ostream& os, const Record& record) {
+    return os << record.first << ' ' << record.second;
+  }
+};
+
+TEST(ExternalSortTest, StableOnRecords) {
+  typedef std::pair<int, std::string> record_type;
+  std::vector<record_type> records;
+  for (int i = 0; i < 1000; ++i) {
+    records.emplace_back(i * 7 % 10, "r" + std::to_string(i));
+  }
+  std::ostringstream input;
+  for (const auto& record : records) {
+    input << record.first << ' ' << record.second << '\n';
+  }
+  auto by_first = [](const record_type& lhs, const record_type& rhs) {
+    return lhs.first < rhs.first;
+  };
+  std::stable_sort(records.begin(), records.end(), by_first);
+
+  ExternalSortOptions options;
+  options.memory_budget = sizeof(Record) * 30;
+  options.fan_in = 3;
+  std::istringstream is(input.str());
+  std::stringstream os;
+  sorting::external_sort<Record>(is, os, by_first, options);
+  for (const auto& record : records) {
+    Record actual;
+    ASSERT_TRUE(os >> actual);
+    EXPECT_EQ(actual.first, record.first);
+    EXPECT_EQ(actual.second, record.second);
+  }
+}
+
+template <typename T>
+class SortSmallTest : public testing::Test {};
+
+typedef ::testing::Types<std::int32_t, std::int64_t, float, double>
+    NetworkTypes;
+TYPED_TEST_SUITE(SortSmallTest, NetworkTypes);
+
+TYPED_TEST(SortSmallTest, MatchesStdSort) {
+  typedef std::numeric_limits<TypeParam> limits;
+  std::srand(31);
+  for (int n = 0; n <= 100; ++n) {
+    for (int round = 0; round < 20; ++round) {
+      std::vector<TypeParam> seq(n);
+      for (auto& value : seq) {
+        switch (std::rand() % 8) {
+          case 0:
+            value = limits::lowest();
+            break;
+          case 1:
+            value = limits::max();
+            break;
+          default:
+            value = static_cast<TypeParam>(std::rand() % 200 - 100);
+            if (std::rand() % 2) value *= static_cast<TypeParam>(1 << 24);
+        }
+      }
+      std::vector<TypeParam> expected(seq);
+      std::sort(expected.begin(), expected.end());
+      sorting::sort_small(seq.begin(), seq.end());
+      ASSERT_EQ(seq, expected) << n;
+    }
+  }
+
+  // quick sorts finish partitions with networks
+  std::vector<TypeParam> seq(10000);
+  for (auto& value : seq) value = static_cast<TypeParam>(std::rand() % 1000);
+  std::vector<TypeParam> expected(seq), actual(seq);
+  std::sort(expected.begin(), expected.end());
+  sorting::intro_sort(actual.begin(), actual.end());
+  EXPECT_EQ(actual, expected);
+  sorting::quick_sort(seq.begin(), seq.end());
+  EXPECT_EQ(seq, expected);
+}
+
+template <typename T>
+class SignedZeroTest : public testing::Test {};
+
+typedef ::testing::Types<float, double> FloatingTypes;
+TYPED_TEST_SUITE(SignedZeroTest, FloatingTypes);
+
+// -0.0 and +0.0 compare equal, a network must move them, not merge them
+TYPED_TEST(SignedZeroTest, SortsArePermutations) {
+  auto negative_zeros = [](const std::vector<TypeParam>& seq) {
+    return std::count_if(seq.begin(), seq.end(), [](TypeParam value) {
+      return 0 == value && std::signbit(value);
+    });
+  };
+  std::srand(2024);
+  std::vector<TypeParam> seq(1000);
+  for (auto& value : seq) {
+    switch (std::rand() % 3) {
+      case 0:
+        value = static_cast<TypeParam>(-0.0);
+        break;
+      case 1:
+        value = static_cast<TypeParam>(0.0);
+        break;
+      default:
+        value = static_cast<TypeParam>(std::rand() % 100 - 50);
+    }
+  }
+  const auto expected = negative_zeros(seq);
+  for (size_t n : {size_t(8), size_t(37), size_t(64)}) {
+    std::vector<TypeParam> prefix(seq.begin(), seq.begin() + n), actual(prefix);
+    sorting::sort_small(actual.begin(), actual.end());
+    EXPECT_TRUE(std::is_sorted(actual.begin(), actual.end())) << n;
+    EXPECT_EQ(negative_zeros(actual), negative_zeros(prefix)) << n;
+  }
+  std::vector<TypeParam> actual(seq);
+  sorting::intro_sort(actual.begin(), actual.end());
+  EXPECT_TRUE(std::is_sorted(actual.begin(), actual.end()));
+  EXPECT_EQ(negative_zeros(actual), expected);
+  actual = seq;
+  sorting::quick_sort(actual.begin(), actual.end());
+  EXPECT_EQ(negative_zeros(actual), expected);
+  actual = seq;
+  sorting::parallel_sort(actual.begin(), actual.end(),
+                         std::less<TypeParam>(), 2);
+  EXPECT_EQ(negative_zeros(actual), expected);
+}
+
 TEST_F(SortingTest, IndirectSort) {
   std::vector<int> seq;
   for (size_t t = 0; t < lengths_.size(); ++t) {
@@ -171,6 +538,57 @@ TEST_F(SortingTest, IndirectSort) {
   }
 }
 
+TEST(PermutationTest, StructureOfArrays) {
+  std::srand(29);
+  const std::size_t n = 5000;
+  std::vector<std::uint32_t> rows(n), columns(n);
+  std::vector<double> values(n);
+  std::vector<std::tuple<double, std::uint32_t, std::uint32_t, std::size_t>>
+      expected;
+  for (std::size_t i = 0; i < n; ++i) {
+    rows[i] = std::rand() % 50;
+    columns[i] = std::rand() % 50;
+    values[i] = std::rand() % 20;
+    expected.emplace_back(-values[i], rows[i], columns[i], i);
+  }
+  std::sort(expected.begin(), expected.end());
+
+  // by value descending, then row, then column
+  std::vector<std::uint32_t> index(n);
+  sorting::sort_permutation(
+      n, index.begin(),
+      [&](std::size_t i) {
+        return std::make_tuple(-values[i], rows[i], columns[i]);
+      },
+      std::less<std::tuple<double, std::uint32_t, std::uint32_t>>());
+  for (std::size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(index[i], std::get<3>(expected[i]));
+  }
+
+  sorting::apply_permutation(index.begin(), index.end(), rows.begin(),
+                             columns.begin(), values.data());
+  for (std::size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(index[i], i);
+    EXPECT_EQ(values[i], -std::get<0>(expected[i]));
+    EXPECT_EQ(rows[i], std::get<1>(expected[i]));
+    EXPECT_EQ(columns[i], std::get<2>(expected[i]));
+  }
+}
+
+TEST(PermutationTest, ItWorks) {
+  std::vector<std::string> words = {"pear", "fig", "apple", "fig", "kiwi"};
+  std::vector<unsigned char> index(words.size());
+  sorting::sort_permutation(words.begin(), words.end(), index.begin());
+  EXPECT_THAT(index, ElementsAreArray({2, 1, 3, 4, 0}));
+
+  std::vector<std::uint8_t> small(300);
+  std::vector<int> seq(300);
+  EXPECT_THROW(sorting::sort_permutation(seq.begin(), seq.end(), small.begin()),
+               std::length_error);
+  EXPECT_NO_THROW(
+      sorting::sort_permutation(seq.begin(), seq.begin() + 256, small.begin()));
+}
+
 TEST(BucketSort, ItWorks) {
   std::vector<int> values = {3, 4, 1, 2, 8, 7, 10, 15, 12, 20, 0x7fffffff, -3};
   int len = static_cast<int>(values.size());
@@ -232,5 +650,65 @@ TEST_F(SelectTest, HeapSelect) {
   }
 }
 
+TEST(TopKTest, Streaming) {
+  std::vector<int> values = {3, 4, 1, 2, 8, 7, 10, 20, 15, 12, 15, -3};
+  for (std::size_t k : {0, 1, 5, 12, 20}) {
+    TopK<int, std::greater<int>> top(k);
+    for (int value : values) top.push(value);
+    std::vector<int> expected(values);
+    std::sort(expected.begin(), expected.end(), std::greater<int>());
+    expected.resize(std::min(k, values.size()));
+    EXPECT_EQ(top.size(), expected.size()) << k;
+    EXPECT_THAT(top.release(), ElementsAreArray(expected)) << k;
+    EXPECT_TRUE(top.empty());
+  }
+
+  TopK<int> lhs(3), rhs(3);
+  for (int value : {5, 9, 2, 7}) lhs.push(value);
+  for (int value : {1, 8, 6}) rhs.push(value);
+  lhs.merge(rhs);
+  EXPECT_THAT(lhs.release(), ElementsAreArray({1, 2, 5}));
+
+  GroupedTopK<int> grouped(2);
+  grouped.push(2, 5);
+  grouped.push(0, 4);
+  grouped.push(2, 3);
+  grouped.push(2, 9);
+  std::vector<std::vector<int>> expected = {{4}, {}, {3, 5}};
+  EXPECT_EQ(grouped.group_count(), 3u);
+  EXPECT_EQ(grouped.release(), expected);
+}
+
+TEST(TopKTest, ParallelMatchesSort) {
+  std::vector<std::uint64_t> values(300000);
+  std::srand(7);
+  for (auto& value : values) value = std::rand() % 100000;
+  auto by_value = [](std::uint64_t lhs, std::uint64_t rhs) {
+    return lhs > rhs;
+  };
+  auto row = [](std::uint64_t value) { return value % 13; };
+  std::vector<std::uint64_t> sorted(values);
+  std::sort(sorted.begin(), sorted.end(), by_value);
+  std::vector<std::vector<std::uint64_t>> rows(13);
+  for (std::uint64_t value : sorted) {
+    if (rows[row(value)].size() < 50) rows[row(value)].push_back(value);
+  }
+
+  for (std::size_t threads : {1, 2, 4}) {
+    for (std::size_t k : {1, 100, 1000}) {
+      auto top = parallel_top_k(values.begin(), values.end(), k, by_value,
+                                threads);
+      EXPECT_TRUE(std::equal(top.begin(), top.end(), sorted.begin()));
+      EXPECT_EQ(top.size(), k) << threads;
+    }
+    EXPECT_EQ(parallel_grouped_top_k(values.begin(), values.end(), 50, row,
+                                     by_value, threads),
+              rows)
+        << threads;
+  }
+  EXPECT_THAT(parallel_top_k(values.begin(), values.begin(), 3),
+              ElementsAreArray(std::vector<std::uint64_t>()));
+}
+
 }  // namespace
 }  // namespace sorting
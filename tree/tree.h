@@ -3,14 +3,26 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <new>
 #include <queue>
 #include <stack>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "parallel/parallel.h"
+
 namespace tree {
 
 typedef std::size_t size_type;      // unsigned size type
@@ -442,19 +454,236 @@ void traverse_postorder_tricky(NodePtrT root, UnaryFunction op) {
   }
 }
 
+// =============================================================================
+// stackless traversals: constant extra space, so degenerate trees of any
+// height are safe. the *_parent versions climb back through parent links and
+// leave the tree untouched; root may be a subtree, traversal stops when it
+// climbs back to root. the *_morris versions need no parent links, but
+// thread right links temporarily, so op must not look at the tree.
+
+namespace internal {
+
+// hint the cache about a node we are about to step into, nullptr is fine
+template <typename NodePtrT>
+inline void prefetch_node(NodePtrT p) {
+  __builtin_prefetch(static_cast<const void*>(p));
+}
+
+// first node of inorder in subtree root, right children on the way down are
+// prefetched since they are visited right after their parents
+template <typename NodePtrT>
+NodePtrT leftmost(NodePtrT root) {
+  for (; root->left; root = root->left) {
+    prefetch_node(root->right);
+  }
+  prefetch_node(root->right);
+  return root;
+}
+
+// first node of postorder in subtree root: the deepest leftmost leaf
+template <typename NodePtrT>
+NodePtrT first_leaf(NodePtrT root) {
+  for (;;) {
+    if (root->left) {
+      root = root->left;
+    } else if (root->right) {
+      root = root->right;
+    } else {
+      return root;
+    }
+  }
+}
+
+// preorder walk calling function(node, depth), depth of root is 0
+template <typename NodePtrT, typename Function>
+void for_each_preorder(NodePtrT root, Function function) {
+  if (nullptr == root) {
+    return;
+  }
+  NodePtrT curr = root;
+  ssize_type depth = 0;
+  for (;;) {
+    prefetch_node(curr->left);
+    prefetch_node(curr->right);
+    function(curr, depth);
+    if (curr->left) {
+      curr = curr->left;
+      ++depth;
+      continue;
+    }
+    if (curr->right) {
+      curr = curr->right;
+      ++depth;
+      continue;
+    }
+    // climb until a left child whose parent has a right subtree
+    for (;;) {
+      if (curr == root) {
+        return;
+      }
+      NodePtrT parent = curr->parent;
+      if (curr == parent->left && parent->right) {
+        curr = parent->right;
+        break;
+      }
+      curr = parent;
+      --depth;
+    }
+  }
+}
+
+}  // namespace internal
+
+template <typename NodePtrT, typename UnaryFunction>
+void traverse_preorder_parent(NodePtrT root, UnaryFunction op) {
+  internal::for_each_preorder(root,
+                              [&op](NodePtrT p, ssize_type) { op(p->value); });
+}
+
+template <typename NodePtrT, typename UnaryFunction>
+void traverse_inorder_parent(NodePtrT root, UnaryFunction op) {
+  if (nullptr == root) {
+    return;
+  }
+  NodePtrT curr = internal::leftmost(root);
+  for (;;) {
+    op(curr->value);
+    if (curr->right) {  // successor is leftmost of right subtree
+      curr = internal::leftmost(curr->right);
+      continue;
+    }
+    // successor is the first ancestor reached from its left
+    NodePtrT child = nullptr;
+    do {
+      if (curr == root) {
+        return;
+      }
+      child = curr;
+      curr = curr->parent;
+    } while (child == curr->right);
+  }
+}
+
+template <typename NodePtrT, typename UnaryFunction>
+void traverse_postorder_parent(NodePtrT root, UnaryFunction op) {
+  if (nullptr == root) {
+    return;
+  }
+  NodePtrT curr = internal::first_leaf(root);
+  for (;;) {
+    op(curr->value);
+    if (curr == root) {
+      return;
+    }
+    NodePtrT parent = curr->parent;
+    internal::prefetch_node(parent->right);
+    if (curr == parent->left && parent->right) {
+      curr = internal::first_leaf(parent->right);
+    } else {
+      curr = parent;
+    }
+  }
+}
+
+// pre-condition: root is not shared with concurrent readers
+// remarks: the tree is restored before return
+template <typename NodeT, typename UnaryFunction>
+void traverse_inorder_morris(NodeT* root, UnaryFunction op) {
+  NodeT* curr = root;
+  while (curr != nullptr) {
+    internal::prefetch_node(curr->left);
+    if (nullptr == curr->left) {
+      op(curr->value);
+      curr = curr->right;
+      continue;
+    }
+    NodeT* pred = curr->left;  // rightmost of left subtree
+    while (pred->right != nullptr && pred->right != curr) {
+      pred = pred->right;
+    }
+    if (nullptr == pred->right) {  // first visit: thread back to curr
+      pred->right = curr;
+      curr = curr->left;
+    } else {  // second visit: left subtree done, unthread
+      pred->right = nullptr;
+      op(curr->value);
+      curr = curr->right;
+    }
+  }
+}
+
+// pre-condition: root is not shared with concurrent readers
+// remarks: the tree is restored before return
+template <typename NodeT, typename UnaryFunction>
+void traverse_preorder_morris(NodeT* root, UnaryFunction op) {
+  NodeT* curr = root;
+  while (curr != nullptr) {
+    internal::prefetch_node(curr->left);
+    if (nullptr == curr->left) {
+      op(curr->value);
+      curr = curr->right;
+      continue;
+    }
+    NodeT* pred = curr->left;
+    while (pred->right != nullptr && pred->right != curr) {
+      pred = pred->right;
+    }
+    if (nullptr == pred->right) {
+      op(curr->value);  // visit before descending left
+      pred->right = curr;
+      curr = curr->left;
+    } else {
+      pred->right = nullptr;
+      curr = curr->right;
+    }
+  }
+}
+
+// visit every node once in no particular order, op is called concurrently
+// from up to thread_count threads, 0 means one per hardware thread.
+// remarks: the top levels are visited by the caller until there are about
+//  four subtrees per thread, then subtrees are walked in parallel by
+//  traverse_preorder_parent. a path-like tree stays on the caller.
+template <typename NodePtrT, typename UnaryFunction>
+void traverse_parallel(NodePtrT root, UnaryFunction op,
+                       size_type thread_count = 0) {
+  if (nullptr == root) {
+    return;
+  }
+  size_type threads = parallel::thread_count(
+      thread_count, std::numeric_limits<size_type>::max());
+  std::vector<NodePtrT> frontier(1, root), next;
+  while (!frontier.empty() && frontier.size() < 4 * threads) {
+    next.clear();
+    for (NodePtrT p : frontier) {
+      op(p->value);
+      if (p->left) next.push_back(p->left);
+      if (p->right) next.push_back(p->right);
+    }
+    frontier.swap(next);
+  }
+  parallel::for_each_range(
+      frontier.size(), threads, [&frontier, &op](size_type begin,
+                                                 size_type end, size_type) {
+        for (size_type i = begin; i < end; ++i) {
+          traverse_preorder_parent(frontier[i], op);
+        }
+      });
+}
+
 template <typename NodePtrT, typename UnaryFunction>
 void traverse_preorder(NodePtrT root, UnaryFunction op) {
-  traverse_preorder_recursive(root, op);
+  traverse_preorder_parent(root, op);
 }
 
 template <typename NodePtrT, typename UnaryFunction>
 void traverse_inorder(NodePtrT root, UnaryFunction op) {
-  traverse_inorder_recursive(root, op);
+  traverse_inorder_parent(root, op);
 }
 
 template <typename NodePtrT, typename UnaryFunction>
 void traverse_postorder(NodePtrT root, UnaryFunction op) {
-  traverse_postorder_recursive(root, op);
+  traverse_postorder_parent(root, op);
 }
 
 template <typename NodePtrT, typename UnaryFunction>
@@ -486,19 +715,20 @@ void traverse_level_order(NodePtrT root, UnaryFunction op) {
 // nullptr tree's height is -1
 template <typename NodeT>
 ssize_type height(const NodeT* root) {
-  if (nullptr == root) {
-    return -1;
-  }
-  return 1 + std::max(height(root->left), height(root->right));
+  ssize_type result = -1;
+  internal::for_each_preorder(root, [&result](const NodeT*, ssize_type depth) {
+    result = std::max(result, depth);
+  });
+  return result;
 }
 
 // how many nodes in tree
 template <typename NodeT>
 size_type count(const NodeT* root) {
-  if (nullptr == root) {
-    return 0;
-  }
-  return 1 + count(root->left) + count(root->right);
+  size_type result = 0;
+  internal::for_each_preorder(
+      root, [&result](const NodeT*, ssize_type) { ++result; });
+  return result;
 }
 
 // search value in binary-search tree
@@ -574,45 +804,76 @@ void update_height(AVLNodeT* root) {
       1 + std::max(avl::height(root->left), avl::height(root->right));
 }
 
+// concept AVLSizedNodeT : public AVLNodeT {
+//     size_type size;  // number of nodes in subtree
+// };
+
+template <typename AVLSizedNodeT>
+size_type size(const AVLSizedNodeT* root) {
+  return root ? root->size : 0;
+}
+
+namespace internal {
+
+template <typename AVLNodeT>
+auto update_size(AVLNodeT* root, int) -> decltype(root->size, void()) {
+  root->size = 1 + avl::size(root->left) + avl::size(root->right);
+}
+
+template <typename AVLNodeT>
+void update_size(AVLNodeT*, long) {}  // node without size field
+
+}  // namespace internal
+
+// update height field, and size field if node has one
+template <typename AVLNodeT>
+void update(AVLNodeT* root) {
+  if (nullptr == root) {
+    return;
+  }
+  avl::update_height(root);
+  avl::internal::update_size(root, 0);
+}
+
 // left-left single rotation
 template <typename AVLNodeT>
 void rotate_left_left(AVLNodeT*& root) {
   tree::rotate_left_left(root);
-  avl::update_height(root->right);
-  avl::update_height(root);
+  avl::update(root->right);
+  avl::update(root);
 }
 
 // right-right single rotation
 template <typename AVLNodeT>
 void rotate_right_right(AVLNodeT*& root) {
   tree::rotate_right_right(root);
-  avl::update_height(root->left);
-  avl::update_height(root);
+  avl::update(root->left);
+  avl::update(root);
 }
 
 // left-right double rotation
 template <typename AVLNodeT>
 void rotate_left_right(AVLNodeT*& root) {
   tree::rotate_left_right(root);
-  avl::update_height(root->left);
-  avl::update_height(root->right);
-  avl::update_height(root);
+  avl::update(root->left);
+  avl::update(root->right);
+  avl::update(root);
 }
 
 // right-left double rotation
 template <typename AVLNodeT>
 void rotate_right_left(AVLNodeT*& root) {
   tree::rotate_right_left(root);
-  avl::update_height(root->left);
-  avl::update_height(root->right);
-  avl::update_height(root);
+  avl::update(root->left);
+  avl::update(root->right);
+  avl::update(root);
 }
 
 // insert new_node into AVL tree root
 // return node that contains new_node->value
 template <typename AVLNodeT, typename BinaryPredicate>
 AVLNodeT* insert(AVLNodeT*& root, AVLNodeT* new_node, BinaryPredicate pred) {
-  AVLNodeT* position = tree::insert(root, new_node);  // bs-tree insertion
+  AVLNodeT* position = tree::insert(root, new_node, pred);  // bs-tree insertion
   if (position != new_node) {
     return position;  // already exists
   }
@@ -631,8 +892,8 @@ AVLNodeT* insert(AVLNodeT*& root, AVLNodeT* new_node, BinaryPredicate pred) {
       } else {  // right-left
         avl::rotate_right_left(p);
       }
-    } else {                  // no need for rebalance
-      avl::update_height(p);  // update height field
+    } else {           // no need for rebalance
+      avl::update(p);  // update height and size fields
     }
   }
   return position;
@@ -644,8 +905,418 @@ AVLNodeT* insert(AVLNodeT*& root, AVLNodeT* new_node) {
                      std::less<typename AVLNodeT::value_type>());
 }
 
+namespace internal {
+
+// rotate where unbalanced and update fields, from p up to the root
+template <typename AVLNodeT>
+void rebalance(AVLNodeT*& root, AVLNodeT* p) {
+  for (; p != nullptr; root = p, p = p->parent) {
+    if (avl::height(p->left) >= avl::height(p->right) + 2) {
+      if (avl::height(p->left->left) >= avl::height(p->left->right)) {
+        avl::rotate_left_left(p);
+      } else {
+        avl::rotate_left_right(p);
+      }
+    } else if (avl::height(p->right) >= avl::height(p->left) + 2) {
+      if (avl::height(p->right->right) >= avl::height(p->right->left)) {
+        avl::rotate_right_right(p);
+      } else {
+        avl::rotate_right_left(p);
+      }
+    } else {
+      avl::update(p);
+    }
+  }
+}
+
+}  // namespace internal
+
+// unlink node from AVL tree root, node itself is not deleted
+// pre-condition: node is in tree root
+template <typename AVLNodeT>
+void erase(AVLNodeT*& root, AVLNodeT* node) {
+  AVLNodeT* start = nullptr;  // lowest node whose subtree changed
+  if (node->left && node->right) {  // successor takes place of node
+    AVLNodeT* next = node->right;
+    while (next->left) {
+      next = next->left;
+    }
+    if (next->parent == node) {
+      start = next;
+    } else {
+      start = next->parent;
+      set_left(next->parent, next->right);
+      set_right(next, node->right);
+    }
+    set_left(next, node->left);
+    replace_child(node, next);
+  } else {  // only child takes place of node
+    AVLNodeT* child = node->left ? node->left : node->right;
+    start = node->parent;
+    if (child) {
+      replace_child(node, child);
+    } else if (start) {
+      (node == start->left ? start->left : start->right) = nullptr;
+    }
+    if (nullptr == start) {
+      root = child;
+    }
+  }
+  node->parent = node->left = node->right = nullptr;
+  avl::internal::rebalance(root, start);
+}
+
 }  // namespace avl
 
+// ordered map on an AVL tree whose nodes count their subtrees, which gives
+// rank() and select() in O(log n) besides insert, erase and find.
+// remarks: nodes come from a pool owned by the map, so neighbours in
+//  insertion order share cache lines and clear() frees everything at once.
+//  assign_sorted() builds a perfectly balanced tree in O(n) with nodes laid
+//  out in key order. not copyable.
+template <typename Key, typename T, typename Compare = std::less<Key> >
+class AVLMap {
+ public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<const Key, T> value_type;
+  typedef Compare key_compare;
+  typedef tree::size_type size_type;
+
+ private:
+  struct Node {
+    typedef AVLMap::value_type value_type;
+    value_type value;
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node* parent = nullptr;
+    ssize_type height = 0;
+    size_type size = 1;
+    template <typename... Args>
+    explicit Node(Args&&... args) : value(std::forward<Args>(args)...) {}
+  };
+
+  struct NodeCompare {
+    Compare comp;
+    bool operator()(const value_type& lhs, const value_type& rhs) const {
+      return comp(lhs.first, rhs.first);
+    }
+  };
+
+  template <bool Const>
+  class Iterator {
+   public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef AVLMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<Const, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<Const, const value_type&,
+                                      value_type&>::type reference;
+
+    Iterator() = default;
+    template <bool C, typename = typename std::enable_if<Const || !C>::type>
+    Iterator(const Iterator<C>& other) : node_(other.node_), map_(other.map_) {}
+
+    reference operator*() const { return node_->value; }
+    pointer operator->() const { return &node_->value; }
+
+    Iterator& operator++() {
+      if (node_->right) {
+        node_ = AVLMap::leftmost(node_->right);
+      } else {
+        Node* p = node_->parent;
+        while (p && node_ == p->right) {
+          node_ = p;
+          p = p->parent;
+        }
+        node_ = p;
+      }
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    Iterator& operator--() {
+      if (nullptr == node_) {  // end()
+        node_ = AVLMap::rightmost(map_->root_);
+      } else if (node_->left) {
+        node_ = AVLMap::rightmost(node_->left);
+      } else {
+        Node* p = node_->parent;
+        while (p && node_ == p->left) {
+          node_ = p;
+          p = p->parent;
+        }
+        node_ = p;
+      }
+      return *this;
+    }
+    Iterator operator--(int) {
+      Iterator old = *this;
+      --*this;
+      return old;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return node_ == other.node_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return node_ != other.node_;
+    }
+
+   private:
+    friend class AVLMap;
+    template <bool C>
+    friend class Iterator;
+    Iterator(Node* node, const AVLMap* map) : node_(node), map_(map) {}
+
+    Node* node_ = nullptr;
+    const AVLMap* map_ = nullptr;
+  };
+
+ public:
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  explicit AVLMap(
+      const Compare& comp = Compare(),
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : comp_{comp}, resource_(upstream) {}
+  AVLMap(const AVLMap&) = delete;
+  AVLMap& operator=(const AVLMap&) = delete;
+  ~AVLMap() { destroy_values(); }
+
+  iterator begin() { return iterator(leftmost(root_), this); }
+  iterator end() { return iterator(nullptr, this); }
+  const_iterator begin() const { return const_iterator(leftmost(root_), this); }
+  const_iterator end() const { return const_iterator(nullptr, this); }
+
+  bool empty() const { return nullptr == root_; }
+  size_type size() const { return avl::size(root_); }
+  ssize_type height() const { return avl::height(root_); }
+
+  iterator find(const Key& key) { return iterator(find_node(key), this); }
+  const_iterator find(const Key& key) const {
+    return const_iterator(find_node(key), this);
+  }
+  size_type count(const Key& key) const { return find_node(key) ? 1 : 0; }
+
+  // first element whose key is not less than key
+  iterator lower_bound(const Key& key) {
+    return iterator(lower_bound_node(key), this);
+  }
+  const_iterator lower_bound(const Key& key) const {
+    return const_iterator(lower_bound_node(key), this);
+  }
+
+  T& at(const Key& key) {
+    Node* node = find_node(key);
+    if (nullptr == node) {
+      throw std::out_of_range("key not found");
+    }
+    return node->value.second;
+  }
+  const T& at(const Key& key) const {
+    return const_cast<AVLMap*>(this)->at(key);
+  }
+
+  T& operator[](const Key& key) {
+    Node* node = find_node(key);
+    if (nullptr == node) {
+      node = insert_node(create(key, T()));
+    }
+    return node->value.second;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    Node* node = create(value);
+    Node* position = insert_node(node);
+    return std::make_pair(iterator(position, this), position == node);
+  }
+
+  // return iterator following the erased element
+  // pre-condition: pos is a valid dereferenceable iterator of this map
+  iterator erase(const_iterator pos) {
+    iterator next(pos.node_, this);
+    ++next;
+    avl::erase(root_, pos.node_);
+    destroy(pos.node_);
+    return next;
+  }
+
+  size_type erase(const Key& key) {
+    Node* node = find_node(key);
+    if (nullptr == node) {
+      return 0;
+    }
+    avl::erase(root_, node);
+    destroy(node);
+    return 1;
+  }
+
+  // number of keys less than key
+  size_type rank(const Key& key) const {
+    size_type result = 0;
+    for (const Node* p = root_; p != nullptr;) {
+      if (comp_.comp(p->value.first, key)) {
+        result += avl::size(p->left) + 1;
+        p = p->right;
+      } else {
+        p = p->left;
+      }
+    }
+    return result;
+  }
+
+  // element of rank k, that is the (k+1)-th smallest, end() if k >= size()
+  iterator select(size_type k) { return iterator(select_node(k), this); }
+  const_iterator select(size_type k) const {
+    return const_iterator(select_node(k), this);
+  }
+
+  // replace contents by [first, last) in O(n)
+  // pre-condition: keys of [first, last) are strictly increasing, otherwise
+  //  std::invalid_argument is thrown and the map is left empty
+  template <typename ForwardIterator>
+  void assign_sorted(ForwardIterator first, ForwardIterator last) {
+    clear();
+    std::vector<Node*> nodes;
+    nodes.reserve(std::distance(first, last));
+    try {
+      for (; first != last; ++first) {
+        nodes.push_back(create(*first));
+        if (nodes.size() > 1 &&
+            !comp_(nodes[nodes.size() - 2]->value, nodes.back()->value)) {
+          throw std::invalid_argument("keys are not strictly increasing");
+        }
+      }
+    } catch (...) {
+      for (Node* node : nodes) destroy(node);
+      throw;
+    }
+    root_ = build(nodes, 0, nodes.size(), nullptr);
+  }
+
+  void clear() {
+    destroy_values();
+    resource_.release();
+    root_ = nullptr;
+  }
+
+ private:
+  static Node* leftmost(Node* p) {
+    while (p && p->left) p = p->left;
+    return p;
+  }
+
+  static Node* rightmost(Node* p) {
+    while (p && p->right) p = p->right;
+    return p;
+  }
+
+  Node* find_node(const Key& key) const {
+    Node* p = lower_bound_node(key);
+    return p && !comp_.comp(key, p->value.first) ? p : nullptr;
+  }
+
+  Node* lower_bound_node(const Key& key) const {
+    Node* result = nullptr;
+    for (Node* p = root_; p != nullptr;) {
+      if (comp_.comp(p->value.first, key)) {
+        p = p->right;
+      } else {
+        result = p;
+        p = p->left;
+      }
+    }
+    return result;
+  }
+
+  Node* select_node(size_type k) const {
+    for (Node* p = root_; p != nullptr;) {
+      size_type left_size = avl::size(p->left);
+      if (k < left_size) {
+        p = p->left;
+      } else if (k == left_size) {
+        return p;
+      } else {
+        k -= left_size + 1;
+        p = p->right;
+      }
+    }
+    return nullptr;
+  }
+
+  // node already there, or node itself after insertion
+  Node* insert_node(Node* node) {
+    Node* position = avl::insert(root_, node, comp_);
+    if (position != node) {
+      destroy(node);
+    }
+    return position;
+  }
+
+  // balanced tree of nodes[begin, end), children are built before parents
+  static Node* build(const std::vector<Node*>& nodes, size_type begin,
+                     size_type end, Node* parent) {
+    if (begin == end) {
+      return nullptr;
+    }
+    size_type middle = begin + (end - begin) / 2;
+    Node* root = nodes[middle];
+    root->parent = parent;
+    root->left = build(nodes, begin, middle, root);
+    root->right = build(nodes, middle + 1, end, root);
+    avl::update(root);
+    return root;
+  }
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    void* p = resource_.allocate(sizeof(Node), alignof(Node));
+    try {
+      return new (p) Node(std::forward<Args>(args)...);
+    } catch (...) {
+      resource_.deallocate(p, sizeof(Node), alignof(Node));
+      throw;
+    }
+  }
+
+  void destroy(Node* node) {
+    node->~Node();
+    resource_.deallocate(node, sizeof(Node), alignof(Node));
+  }
+
+  // destructors of nodes are skipped on bulk release, except for values
+  void destroy_values() {
+    if (std::is_trivially_destructible<value_type>::value) {
+      return;
+    }
+    for (Node* p = root_; p != nullptr;) {  // children first, unlinked
+      if (p->left) {
+        p = p->left;
+      } else if (p->right) {
+        p = p->right;
+      } else {
+        Node* parent = p->parent;
+        if (parent) {
+          (p == parent->left ? parent->left : parent->right) = nullptr;
+        }
+        p->~Node();
+        p = parent;
+      }
+    }
+  }
+
+  NodeCompare comp_;
+  std::pmr::unsynchronized_pool_resource resource_;
+  Node* root_ = nullptr;
+};
+
 namespace splay {
 
 // return new root of splaying tree, i.e. target
@@ -825,15 +1496,45 @@ NodeT* inorder_postorder_to_tree(RandomAccessIterator1 in_first,
   return root;
 }
 
+namespace internal {
+
+enum { CACHE_LINE_SIZE = 64 };
+
+// allocates storage aligned to a cache line
+template <typename T>
+struct CacheAlignedAllocator {
+  typedef T value_type;
+  CacheAlignedAllocator() = default;
+  template <typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(::operator new(
+        n * sizeof(T), std::align_val_t(CACHE_LINE_SIZE)));
+  }
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(p, std::align_val_t(CACHE_LINE_SIZE));
+  }
+  template <typename U>
+  bool operator==(const CacheAlignedAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const CacheAlignedAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace internal
+
 namespace heap {
 
 // assumption: array index is zero based
 
-size_type left(size_type pos) { return (pos << 1) + 1; }
+inline size_type left(size_type pos) { return (pos << 1) + 1; }
 
-size_type right(size_type pos) { return (pos << 1) + 2; }
+inline size_type right(size_type pos) { return (pos << 1) + 2; }
 
-size_type parent(size_type pos) { return pos ? (pos - 1) >> 1 : 0; }
+inline size_type parent(size_type pos) { return pos ? (pos - 1) >> 1 : 0; }
 
 template <typename RandomAccessIterator, typename BinaryPredicate>
 void percolate_up(RandomAccessIterator first, RandomAccessIterator last,
@@ -944,7 +1645,451 @@ void pop(RandomAccessIterator first, RandomAccessIterator last) {
   pop(first, last, std::less<value_type>());
 }
 
+// =============================================================================
+// d-ary heap: children of pos are D*pos+1, ..., D*pos+D. fewer levels than a
+// binary heap and the D children of a node are adjacent, so percolate_down
+// touches one cache line per level when D*sizeof(value_type) fits one.
+namespace dary {
+
+template <size_type D>
+inline size_type child(size_type pos) {
+  return pos * D + 1;
+}
+
+template <size_type D>
+inline size_type parent(size_type pos) {
+  return pos ? (pos - 1) / D : 0;
+}
+
+template <size_type D, typename RandomAccessIterator, typename BinaryPredicate>
+void percolate_up(RandomAccessIterator first, RandomAccessIterator last,
+                  size_type pos, BinaryPredicate pred) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  if (pos >= size_type(last - first)) {
+    return;  // no need to percolate
+  }
+  value_type value = std::move(first[pos]);
+  while (pos > 0 && pred(first[dary::parent<D>(pos)], value)) {
+    size_type ppos = dary::parent<D>(pos);
+    first[pos] = std::move(first[ppos]);  // nodes flow down
+    pos = ppos;
+  }
+  first[pos] = std::move(value);
+}
+
+template <size_type D, typename RandomAccessIterator, typename BinaryPredicate>
+void percolate_down(RandomAccessIterator first, RandomAccessIterator last,
+                    size_type pos, BinaryPredicate pred) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+      value_type;
+  size_type len = last - first;
+  if (len <= 1 || pos >= len) {
+    return;  // no need to percolate
+  }
+  value_type value = std::move(first[pos]);
+  for (size_type child = 0; (child = dary::child<D>(pos)) < len;
+       pos = child) {
+    size_type end = std::min(child + D, len);
+    for (size_type i = child + 1; i < end; ++i) {
+      if (pred(first[child], first[i])) child = i;
+    }
+    if (pred(first[child], value)) {
+      break;  // no more percolate
+    }
+    first[pos] = std::move(first[child]);  // nodes flow up
+  }
+  first[pos] = std::move(value);
+}
+
+// same as heap::make() with D children per node
+template <size_type D, typename RandomAccessIterator, typename BinaryPredicate>
+void make(RandomAccessIterator first, RandomAccessIterator last,
+          BinaryPredicate pred) {
+  size_type len = last - first;
+  if (len <= 1) {
+    return;  // no need to adjustment
+  }
+  for (size_type pos = dary::parent<D>(len - 1) + 1; pos-- > 0;) {
+    dary::percolate_down<D>(first, last, pos, pred);
+  }
+}
+
+template <size_type D, typename RandomAccessIterator, typename BinaryPredicate>
+void push(RandomAccessIterator first, RandomAccessIterator last,
+          BinaryPredicate pred) {
+  if (last - first > 1) {
+    dary::percolate_up<D>(first, last, last - first - 1, pred);
+  }
+}
+
+template <size_type D, typename RandomAccessIterator, typename BinaryPredicate>
+void pop(RandomAccessIterator first, RandomAccessIterator last,
+         BinaryPredicate pred) {
+  if (last - first > 1) {
+    std::iter_swap(first, last - 1);
+    dary::percolate_down<D>(first, last - 1, 0, pred);
+  }
+}
+
+}  // namespace dary
+
+// priority queue on a D-ary heap, top() is the greatest value by pred as in
+// std::priority_queue.
+// remarks: storage is cache line aligned and the root is stored after D-1
+//  unused slots, so the D children of every node start on a D-element
+//  boundary: with D*sizeof(T) == 64 each group of siblings is one cache line.
+//  T must be default constructible for the unused slots.
+template <typename T, size_type D = 4, typename BinaryPredicate = std::less<T> >
+class DaryHeap {
+ public:
+  explicit DaryHeap(BinaryPredicate pred = BinaryPredicate())
+      : pred_(pred), values_(D - 1) {}
+
+  void push(const T& value) {
+    values_.push_back(value);
+    dary::push<D>(begin(), values_.end(), pred_);
+  }
+
+  void push(T&& value) {
+    values_.push_back(std::move(value));
+    dary::push<D>(begin(), values_.end(), pred_);
+  }
+
+  // pre-condition: !empty()
+  void pop() {
+    dary::pop<D>(begin(), values_.end(), pred_);
+    values_.pop_back();
+  }
+
+  // pre-condition: !empty()
+  const T& top() const { return values_[D - 1]; }
+
+  void reserve(size_type n) { values_.reserve(n + D - 1); }
+  void clear() { values_.resize(D - 1); }
+  size_type size() const { return values_.size() - (D - 1); }
+  bool empty() const { return values_.size() == D - 1; }
+
+ private:
+  typedef std::vector<T, internal::CacheAlignedAllocator<T> > storage_type;
+
+  typename storage_type::iterator begin() { return values_.begin() + (D - 1); }
+
+  BinaryPredicate pred_;
+  storage_type values_;
+};
+
+// addressable priority queue of ids in [0, capacity) with keys, on a D-ary
+// heap. top() is the id with the greatest key by pred, so pass
+// std::greater<Key> for a min queue as used by dijkstra.
+// remarks: positions of ids are tracked, update() and erase() of a queued id
+//  take O(log n), and an id is never queued twice.
+template <typename Key, typename BinaryPredicate = std::less<Key>,
+          size_type D = 4>
+class IndexedHeap {
+ public:
+  typedef size_type id_type;
+
+  explicit IndexedHeap(size_type capacity,
+                       BinaryPredicate pred = BinaryPredicate())
+      : pred_(pred), positions_(capacity, NOT_QUEUED) {}
+
+  bool contains(id_type id) const { return positions_[id] != NOT_QUEUED; }
+
+  // pre-condition: !contains(id)
+  void push(id_type id, const Key& key) {
+    positions_[id] = entries_.size();
+    entries_.push_back(Entry{key, id});
+    sift_up(entries_.size() - 1);
+  }
+
+  // pre-condition: !empty()
+  id_type top() const { return entries_[0].id; }
+  const Key& top_key() const { return entries_[0].key; }
+
+  // pre-condition: !empty()
+  void pop() { erase(entries_[0].id); }
+
+  // pre-condition: contains(id)
+  const Key& key(id_type id) const { return entries_[positions_[id]].key; }
+
+  // set key of a queued id, moving it either way
+  // pre-condition: contains(id)
+  void update(id_type id, const Key& key) {
+    size_type pos = positions_[id];
+    bool up = pred_(entries_[pos].key, key);
+    entries_[pos].key = key;
+    if (up) {
+      sift_up(pos);
+    } else {
+      sift_down(pos);
+    }
+  }
+
+  // set a key that does not move id away from the top, that is a smaller
+  // key for a min queue
+  // pre-condition: contains(id) && !pred(key, this->key(id))
+  void decrease_key(id_type id, const Key& key) {
+    size_type pos = positions_[id];
+    entries_[pos].key = key;
+    sift_up(pos);
+  }
+
+  // push id or update its key
+  void push_or_update(id_type id, const Key& key) {
+    if (contains(id)) {
+      update(id, key);
+    } else {
+      push(id, key);
+    }
+  }
+
+  // pre-condition: contains(id)
+  void erase(id_type id) {
+    size_type pos = positions_[id];
+    positions_[id] = NOT_QUEUED;
+    if (pos + 1 == entries_.size()) {
+      entries_.pop_back();
+      return;
+    }
+    Key key = entries_[pos].key;
+    place(pos, std::move(entries_.back()));
+    entries_.pop_back();
+    if (pred_(key, entries_[pos].key)) {
+      sift_up(pos);
+    } else {
+      sift_down(pos);
+    }
+  }
+
+  void clear() {
+    for (const Entry& entry : entries_) positions_[entry.id] = NOT_QUEUED;
+    entries_.clear();
+  }
+
+  size_type size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  size_type capacity() const { return positions_.size(); }
+
+ private:
+  static constexpr size_type NOT_QUEUED = std::numeric_limits<size_type>::max();
+
+  struct Entry {
+    Key key;
+    id_type id;
+  };
+
+  void place(size_type pos, Entry&& entry) {
+    positions_[entry.id] = pos;
+    entries_[pos] = std::move(entry);
+  }
+
+  void sift_up(size_type pos) {
+    Entry entry = std::move(entries_[pos]);
+    while (pos > 0 && pred_(entries_[dary::parent<D>(pos)].key, entry.key)) {
+      size_type ppos = dary::parent<D>(pos);
+      place(pos, std::move(entries_[ppos]));
+      pos = ppos;
+    }
+    place(pos, std::move(entry));
+  }
+
+  void sift_down(size_type pos) {
+    size_type len = entries_.size();
+    Entry entry = std::move(entries_[pos]);
+    for (size_type child = 0; (child = dary::child<D>(pos)) < len;
+         pos = child) {
+      size_type end = std::min(child + D, len);
+      for (size_type i = child + 1; i < end; ++i) {
+        if (pred_(entries_[child].key, entries_[i].key)) child = i;
+      }
+      if (!pred_(entry.key, entries_[child].key)) {
+        break;  // no more percolate
+      }
+      place(pos, std::move(entries_[child]));
+    }
+    place(pos, std::move(entry));
+  }
+
+  BinaryPredicate pred_;
+  std::vector<Entry> entries_;
+  std::vector<size_type> positions_;  // index in entries_ or NOT_QUEUED
+};
+
 }  // namespace heap
+// =============================================================================
+// static search trees: built once from sorted keys, then lower_bound() in a
+// layout that needs fewer cache misses than binary search on the sorted
+// array. both answer with ranks in the sorted input, so they can index
+// arrays of data attached to the keys.
+
+namespace internal {
+
+// prefetch the cache line /bytes/ past p, pointer arithmetic done on
+// integers since the address may lie past the array
+inline void prefetch_at(const void* p, std::size_t bytes) {
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(p) + bytes;
+  __builtin_prefetch(reinterpret_cast<const void*>(address));
+}
+
+}  // namespace internal
+
+// binary search tree in Eytzinger (BFS) order: node k has children 2k and
+// 2k+1. the descendants of k four levels down are 16 consecutive nodes, which
+// are prefetched while the four levels above them are searched.
+// remarks: T must be default constructible.
+template <typename T, typename Compare = std::less<T> >
+class EytzingerTree {
+ public:
+  typedef T key_type;
+  typedef tree::size_type size_type;
+
+  // pre-condition: [first, last) is sorted by comp
+  template <typename RandomAccessIterator>
+  EytzingerTree(RandomAccessIterator first, RandomAccessIterator last,
+                Compare comp = Compare())
+      : comp_(comp), keys_(last - first + 1), ranks_(last - first + 1) {
+    build(first, 1, 0);
+  }
+
+  // rank of the first key not less than key, size() if none
+  size_type lower_bound(const T& key) const {
+    const size_type n = size();
+    const T* keys = keys_.data();
+    size_type k = 1;
+    while (k <= n) {
+      internal::prefetch_at(keys, PREFETCH_NODES * k * sizeof(T));
+      k = 2 * k + comp_(keys[k], key);
+    }
+    k >>= __builtin_ffsll(~static_cast<unsigned long long>(k));  // last left
+    return k ? ranks_[k] : n;
+  }
+
+  size_type size() const { return keys_.size() - 1; }
+  bool empty() const { return keys_.size() == 1; }
+
+ private:
+  enum { PREFETCH_NODES = 16 };
+
+  template <typename RandomAccessIterator>
+  size_type build(RandomAccessIterator first, size_type k, size_type rank) {
+    if (k <= size()) {
+      rank = build(first, 2 * k, rank);  // in-order fill
+      keys_[k] = first[rank];
+      ranks_[k] = rank++;
+      rank = build(first, 2 * k + 1, rank);
+    }
+    return rank;
+  }
+
+  Compare comp_;
+  std::vector<T, internal::CacheAlignedAllocator<T> > keys_;  // [0] unused
+  std::vector<size_type> ranks_;
+};
+
+namespace internal {
+
+// number of keys in block[0, B) less than key by comp
+template <size_type B, typename T, typename Compare>
+size_type block_rank(const T* block, const T& key, const Compare& comp) {
+  size_type count = 0;
+  for (size_type i = 0; i < B; ++i) count += comp(block[i], key);
+  return count;
+}
+
+#if defined(__SSE2__)
+// blocks of whole vectors whose mask fits in 32 bits, others take the loop
+template <size_type B>
+typename std::enable_if<B % 4 == 0 && B <= 32, size_type>::type block_rank(
+    const std::int32_t* block, const std::int32_t& key,
+    const std::less<std::int32_t>&) {
+  const __m128i k = _mm_set1_epi32(key);
+  unsigned mask = 0;
+  for (size_type i = 0; i < B; i += 4) {
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(block + i));
+    mask |= unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v))))
+            << i;
+  }
+  return __builtin_popcount(mask);
+}
+#endif
+
+}  // namespace internal
+
+// implicit static B+ tree: the sorted keys, padded to blocks of B, make the
+// bottom layer, and every layer above holds for each block of the layer
+// below the first keys of its right B children. block b has children
+// b*(B+1), ..., b*(B+1)+B, so no pointers are stored, and a block is one
+// cache line for B=16 4-byte keys: a search touches log_{B+1}(n) lines. keys
+// within a block are compared all at once, with SSE2 for std::int32_t and
+// std::less. the rank found in the bottom layer is the answer itself.
+// remarks: padding copies the greatest key, T must be default constructible.
+template <typename T, typename Compare = std::less<T>, size_type B = 16>
+class StaticBTree {
+ public:
+  typedef T key_type;
+  typedef tree::size_type size_type;
+
+  // pre-condition: [first, last) is sorted by comp
+  template <typename RandomAccessIterator>
+  StaticBTree(RandomAccessIterator first, RandomAccessIterator last,
+              Compare comp = Compare())
+      : comp_(comp), size_(last - first) {
+    if (0 == size_) {
+      return;
+    }
+    for (size_type n = size_;; n = upper_keys(n)) {  // layers bottom up
+      offsets_.push_back(keys_.size());
+      keys_.resize(keys_.size() + blocks(n) * B, first[size_ - 1]);
+      if (n <= B) break;
+    }
+    std::copy(first, last, keys_.begin());
+    for (size_type h = 1; h < offsets_.size(); ++h) {
+      size_type layer_size = layer_end(h) - offsets_[h];
+      for (size_type i = 0; i < layer_size; ++i) {
+        size_type k = i / B * (B + 1) + i % B + 1;  // right child of key i
+        for (size_type l = 1; l < h; ++l) k *= B + 1;  // its leftmost leaf
+        if (k * B < size_) keys_[offsets_[h] + i] = keys_[k * B];
+      }
+    }
+  }
+
+  // rank of the first key not less than key, size() if none
+  size_type lower_bound(const T& key) const {
+    if (0 == size_ || comp_(keys_[size_ - 1], key)) {
+      return size_;  // past the greatest key, padding would mislead
+    }
+    const T* keys = keys_.data();
+    size_type k = 0;  // first key of current block within its layer
+    for (size_type h = offsets_.size() - 1; h > 0; --h) {
+      size_type i = internal::block_rank<B>(keys + offsets_[h] + k, key, comp_);
+      k = k * (B + 1) + i * B;
+    }
+    k += internal::block_rank<B>(keys + k, key, comp_);
+    return std::min(k, size_);  // padding ranks are past size()
+  }
+
+  size_type size() const { return size_; }
+  bool empty() const { return 0 == size_; }
+
+ private:
+  static size_type blocks(size_type n) { return (n + B - 1) / B; }
+
+  // keys in the layer above a layer of n keys
+  static size_type upper_keys(size_type n) {
+    return (blocks(n) + B) / (B + 1) * B;
+  }
+
+  size_type layer_end(size_type h) const {
+    return h + 1 < offsets_.size() ? offsets_[h + 1] : keys_.size();
+  }
+
+  Compare comp_;
+  size_type size_;
+  std::vector<T, internal::CacheAlignedAllocator<T> > keys_;
+  std::vector<size_type> offsets_;  // where each layer starts, bottom first
+};
+
 }  // namespace tree
 
 #endif  // TREE_H_
@@ -0,0 +1,203 @@
+// Compares tree::AVLMap against std::map on random keys: insert, find, rank,
+// in-order iteration, erase, and building from sorted input. then compares
+// lower_bound of tree::EytzingerTree and tree::StaticBTree against
+// std::lower_bound on sorted 32-bit keys, and last the traversals of a random
+// binary search tree and of a path-like one.
+// usage: tree_benchmark [key-count [search-key-count]], 10^6 keys and 10^7
+// search keys by default.
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "timing/timing.h"
+#include "tree/tree.h"
+
+namespace {
+
+typedef std::uint64_t key_type;
+
+std::size_t checksum = 0;  // keeps results alive
+
+struct Node {
+  typedef key_type value_type;
+  value_type value = 0;
+  Node* left = nullptr;
+  Node* right = nullptr;
+  Node* parent = nullptr;
+};
+
+template <typename Function>
+double measure(Function function) {
+  timing::Timer timer;
+  timer.start();
+  function();
+  timer.stop();
+  return timer.duration();
+}
+
+// times the stack, parent-link, morris and parallel traversals of root
+void report_traversals(const char* shape, Node* root) {
+  std::size_t sum = 0;
+  auto add = [&sum](key_type value) { sum += value; };
+  double stack_seconds =
+      measure([&] { tree::traverse_inorder_stack(root, add); });
+  double parent_seconds =
+      measure([&] { tree::traverse_inorder_parent(root, add); });
+  double morris_seconds =
+      measure([&] { tree::traverse_inorder_morris(root, add); });
+  std::atomic<std::size_t> total(0);
+  double parallel_seconds = measure([&] {
+    tree::traverse_parallel(root, [&total](key_type value) {
+      total.fetch_add(value, std::memory_order_relaxed);
+    });
+  });
+  checksum += sum + total;
+  std::cout << std::setw(10) << shape << std::setw(12) << stack_seconds
+            << std::setw(12) << parent_seconds << std::setw(12)
+            << morris_seconds << std::setw(12) << parallel_seconds
+            << std::endl;
+}
+
+// times avl then standard, and prints both
+template <typename Function1, typename Function2>
+void report(const char* operation, Function1 avl, Function2 standard) {
+  double avl_seconds = measure(avl);
+  double standard_seconds = measure(standard);
+  std::cout << std::fixed << std::setprecision(3) << std::setw(10) << operation
+            << std::setw(12) << avl_seconds << std::setw(12)
+            << standard_seconds << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::vector<key_type> keys(n);
+  std::mt19937_64 rng(2024);
+  for (auto& key : keys) key = rng();
+  std::vector<key_type> probes(keys);
+  std::shuffle(probes.begin(), probes.end(), rng);
+
+  tree::AVLMap<key_type, key_type> avl;
+  std::map<key_type, key_type> standard;
+  std::cout << "keys: " << n << ", seconds" << std::endl;
+  std::cout << std::setw(10) << "operation" << std::setw(12) << "AVLMap"
+            << std::setw(12) << "std::map" << std::endl;
+
+  report("insert", [&] {
+           for (key_type key : keys) avl.insert(std::make_pair(key, key));
+         },
+         [&] {
+           for (key_type key : keys) standard.insert(std::make_pair(key, key));
+         });
+  report("find", [&] {
+           for (key_type key : probes) checksum += avl.find(key)->second;
+         },
+         [&] {
+           for (key_type key : probes) checksum += standard.find(key)->second;
+         });
+  report("iterate", [&] {
+           for (const auto& kv : avl) checksum += kv.second;
+         },
+         [&] {
+           for (const auto& kv : standard) checksum += kv.second;
+         });
+  std::size_t selects = std::min<std::size_t>(n, 10);  // O(n) on std::map
+  report("rank", [&] {
+           for (std::size_t i = 0; i < selects; ++i) {
+             checksum += avl.rank(probes[i]);
+           }
+         },
+         [&] {  // std::map has no order statistics
+           for (std::size_t i = 0; i < selects; ++i) {
+             checksum += std::distance(standard.begin(),
+                                       standard.lower_bound(probes[i]));
+           }
+         });
+  report("erase", [&] {
+           for (key_type key : probes) checksum += avl.erase(key);
+         },
+         [&] {
+           for (key_type key : probes) checksum += standard.erase(key);
+         });
+
+  std::vector<std::pair<key_type, key_type> > sorted;
+  sorted.reserve(n);
+  for (key_type key : keys) sorted.push_back(std::make_pair(key, key));
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  report("build",
+         [&] { avl.assign_sorted(sorted.begin(), sorted.end()); },
+         [&] {
+           standard = std::map<key_type, key_type>(sorted.begin(),
+                                                   sorted.end());
+         });
+  report("find", [&] {
+           for (key_type key : probes) checksum += avl.find(key)->second;
+         },
+         [&] {
+           for (key_type key : probes) checksum += standard.find(key)->second;
+         });
+
+  // static search trees on random 32-bit keys, queried with random keys
+  std::size_t m = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+  std::vector<std::int32_t> search_keys(m);
+  std::vector<std::int32_t> queries(std::min<std::size_t>(m, 1000000));
+  for (auto& key : search_keys) key = static_cast<std::int32_t>(rng());
+  for (auto& key : queries) key = static_cast<std::int32_t>(rng());
+  std::sort(search_keys.begin(), search_keys.end());
+  tree::EytzingerTree<std::int32_t> eytzinger(search_keys.begin(),
+                                              search_keys.end());
+  tree::StaticBTree<std::int32_t> btree(search_keys.begin(), search_keys.end());
+  std::cout << "search keys: " << m << ", queries: " << queries.size()
+            << ", seconds" << std::endl;
+  std::cout << std::setw(12) << "Eytzinger" << std::setw(14) << "StaticBTree"
+            << std::setw(18) << "std::lower_bound" << std::endl;
+  double eytzinger_seconds = measure([&] {
+    for (std::int32_t key : queries) checksum += eytzinger.lower_bound(key);
+  });
+  double btree_seconds = measure([&] {
+    for (std::int32_t key : queries) checksum += btree.lower_bound(key);
+  });
+  double standard_seconds = measure([&] {
+    auto first = search_keys.begin(), last = search_keys.end();
+    for (std::int32_t key : queries) {
+      checksum += std::lower_bound(first, last, key) - first;
+    }
+  });
+  std::cout << std::setw(12) << eytzinger_seconds << std::setw(14)
+            << btree_seconds << std::setw(18) << standard_seconds << std::endl;
+
+  // node traversals, in-order except the unordered parallel one
+  std::vector<Node> nodes(n);
+  Node* root = nullptr;
+  for (std::size_t i = 0; i < n; ++i) {
+    nodes[i].value = keys[i];
+    tree::insert(root, &nodes[i]);
+  }
+  std::cout << "nodes: " << n << ", seconds" << std::endl;
+  std::cout << std::setw(10) << "shape" << std::setw(12) << "stack"
+            << std::setw(12) << "parent" << std::setw(12) << "morris"
+            << std::setw(12) << "parallel" << std::endl;
+  report_traversals("random", root);
+  for (std::size_t i = 0; i < n; ++i) {  // zigzag path
+    nodes[i].left = nodes[i].right = nodes[i].parent = nullptr;
+    if (i % 2) {
+      tree::set_left(&nodes[i - 1], &nodes[i]);
+    } else if (i > 0) {
+      tree::set_right(&nodes[i - 1], &nodes[i]);
+    }
+  }
+  report_traversals("path", &nodes[0]);
+  std::cerr << "checksum: " << checksum << std::endl;
+  return 0;
+}
@@ -1,9 +1,16 @@
 #include "tree.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -333,6 +340,90 @@ TEST(TraversalTest, ItWorks) {
   c.values.clear();
   tree::traverse_preorder_tricky(p, [&c](int v) { c.collect(v); });
   EXPECT_THAT(c.values, ElementsAreArray(preorder));
+
+  c.values.clear();
+  tree::traverse_inorder_parent(p, [&c](int v) { c.collect(v); });
+  EXPECT_THAT(c.values, ElementsAreArray(inorder));
+
+  c.values.clear();
+  tree::traverse_postorder_parent(p, [&c](int v) { c.collect(v); });
+  EXPECT_THAT(c.values, ElementsAreArray(postorder));
+
+  c.values.clear();
+  tree::traverse_preorder_parent(p, [&c](int v) { c.collect(v); });
+  EXPECT_THAT(c.values, ElementsAreArray(preorder));
+
+  c.values.clear();
+  tree::traverse_inorder_morris(p, [&c](int v) { c.collect(v); });
+  EXPECT_THAT(c.values, ElementsAreArray(inorder));
+
+  c.values.clear();
+  tree::traverse_preorder_morris(p, [&c](int v) { c.collect(v); });
+  EXPECT_THAT(c.values, ElementsAreArray(preorder));
+  EXPECT_EQ(nullptr, nodes[6].right);  // threads are removed
+  EXPECT_EQ(nullptr, nodes[4].right);
+
+  c.values.clear();
+  tree::traverse_postorder_parent(&nodes[1], [&c](int v) { c.collect(v); });
+  EXPECT_THAT(c.values, ElementsAreArray({3, 6, 4, 1}));  // subtree only
+
+  c.values.clear();
+  tree::traverse_parallel(p, [&c](int v) { c.collect(v); }, 1);
+  std::sort(c.values.begin(), c.values.end());
+  EXPECT_THAT(c.values, ElementsAreArray(level_order));
+}
+
+TEST(TraversalTest, Degenerate) {
+  const int n = 1000000;
+  std::vector<BSNode<int>> nodes(n);
+  for (int i = 0; i < n; ++i) {
+    nodes[i] = BSNode<int>(i);
+    if (i % 2) {  // zigzag path, left and right children alternate
+      tree::set_left(&nodes[i - 1], &nodes[i]);
+    } else if (i > 0) {
+      tree::set_right(&nodes[i - 1], &nodes[i]);
+    }
+  }
+  BSNode<int>* root = &nodes[0];
+  EXPECT_EQ(tree::height(root), n - 1);
+  EXPECT_EQ(tree::count(root), size_t(n));
+
+  int expected = 0;
+  bool ordered = true;
+  tree::traverse_preorder(root, [&](int v) { ordered &= v == expected++; });
+  EXPECT_TRUE(ordered);
+
+  expected = n - 1;
+  tree::traverse_postorder(root, [&](int v) { ordered &= v == expected--; });
+  EXPECT_TRUE(ordered);
+
+  int visited = 0;
+  tree::traverse_inorder(root, [&visited](int) { ++visited; });
+  EXPECT_EQ(visited, n);
+  visited = 0;
+  tree::traverse_inorder_morris(root, [&visited](int) { ++visited; });
+  EXPECT_EQ(visited, n);
+  visited = 0;
+  tree::traverse_parallel(root, [&visited](int) { ++visited; }, 1);
+  EXPECT_EQ(visited, n);
+}
+
+TEST(TraversalTest, Parallel) {
+  std::vector<int> keys(1 << 16);
+  for (size_t i = 0; i < keys.size(); ++i) keys[i] = i;
+  std::srand(2024);
+  for (size_t i = keys.size() - 1; i > 0; --i) {
+    std::swap(keys[i], keys[std::rand() % (i + 1)]);
+  }
+  std::vector<BSNode<int>> nodes(keys.size());
+  BSNode<int>* root = nullptr;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i] = BSNode<int>(keys[i]);
+    tree::insert(root, &nodes[i]);
+  }
+  std::vector<int> visits(keys.size(), 0);
+  tree::traverse_parallel(root, [&visits](int v) { ++visits[v]; }, 4);
+  EXPECT_EQ(std::count(visits.begin(), visits.end(), 1), int(keys.size()));
 }
 
 TEST(ObserverTest, ItWorks) {
@@ -1086,5 +1177,247 @@ TEST(HeapTest, Pop) {
               ElementsAreArray({14, 19, 16, 26, 21, 19, 68, 65, 31, 32, 13}));
 }
 
+TEST(DaryHeapTest, RangeFunctions) {
+  std::srand(11);
+  std::vector<int> values(1000);
+  for (auto& value : values) value = std::rand() % 100;
+  std::vector<int> sorted(values);
+  std::sort(sorted.begin(), sorted.end(), std::greater<int>());
+
+  std::vector<int> heap(values);
+  tree::heap::dary::make<8>(heap.begin(), heap.end(), std::less<int>());
+  for (size_type pos = 1; pos < heap.size(); ++pos) {
+    ASSERT_LE(heap[pos], heap[tree::heap::dary::parent<8>(pos)]) << pos;
+  }
+  std::vector<int> popped;
+  for (auto last = heap.end(); last != heap.begin(); --last) {
+    popped.push_back(heap.front());
+    tree::heap::dary::pop<8>(heap.begin(), last, std::less<int>());
+  }
+  EXPECT_EQ(popped, sorted);
+
+  heap.clear();
+  for (int value : values) {
+    heap.push_back(value);
+    tree::heap::dary::push<4>(heap.begin(), heap.end(), std::less<int>());
+  }
+  for (size_type pos = 1; pos < heap.size(); ++pos) {
+    ASSERT_LE(heap[pos], heap[tree::heap::dary::parent<4>(pos)]) << pos;
+  }
+  EXPECT_EQ(tree::heap::dary::child<4>(0), 1u);
+  EXPECT_EQ(tree::heap::dary::child<4>(2), 9u);
+  EXPECT_EQ(tree::heap::dary::parent<4>(12), 2u);
+}
+
+TEST(DaryHeapTest, MatchesPriorityQueue) {
+  std::srand(12);
+  tree::heap::DaryHeap<long, 8, std::greater<long>> heap;
+  std::priority_queue<long, std::vector<long>, std::greater<long>> expected;
+  for (int i = 0; i < 5000; ++i) {
+    if (std::rand() % 3 == 0 && !expected.empty()) {
+      ASSERT_EQ(heap.top(), expected.top());
+      heap.pop();
+      expected.pop();
+    } else {
+      long value = std::rand() % 1000;
+      heap.push(value);
+      expected.push(value);
+    }
+    ASSERT_EQ(heap.size(), expected.size());
+  }
+  heap.clear();
+  EXPECT_TRUE(heap.empty());
+}
+
+TEST(IndexedHeapTest, DecreaseKey) {
+  std::srand(13);
+  const size_type n = 200;
+  tree::heap::IndexedHeap<int, std::greater<int>> heap(n);
+  std::vector<int> keys(n, -1);  // -1: not queued
+  for (int i = 0; i < 20000; ++i) {
+    size_type id = std::rand() % n;
+    int key = std::rand() % 1000;
+    switch (std::rand() % 4) {
+      case 0:
+        heap.push_or_update(id, key);
+        keys[id] = key;
+        break;
+      case 1:
+        if (heap.contains(id) && key <= keys[id]) {
+          heap.decrease_key(id, key);
+          keys[id] = key;
+        }
+        break;
+      case 2:
+        if (heap.contains(id)) {
+          heap.erase(id);
+          keys[id] = -1;
+        }
+        break;
+      default:
+        if (!heap.empty()) {
+          auto min = std::min_element(
+              keys.begin(), keys.end(), [](int lhs, int rhs) {
+                return rhs < 0 || (lhs >= 0 && lhs < rhs);  // skip -1
+              });
+          ASSERT_EQ(heap.top_key(), *min);
+          ASSERT_EQ(keys[heap.top()], *min);
+          keys[heap.top()] = -1;
+          heap.pop();
+        }
+        break;
+    }
+    ASSERT_EQ(heap.contains(id), keys[id] >= 0);
+    ASSERT_EQ(heap.size(),
+              size_type(n - std::count(keys.begin(), keys.end(), -1)));
+  }
+  heap.clear();
+  EXPECT_TRUE(heap.empty());
+  EXPECT_FALSE(heap.contains(0));
+}
+
+TEST(AVLMapTest, MatchesStdMap) {
+  std::srand(21);
+  tree::AVLMap<int, std::string> map;
+  std::map<int, std::string> expected;
+  for (int i = 0; i < 20000; ++i) {
+    int key = std::rand() % 1000;
+    switch (std::rand() % 4) {
+      case 0:
+        map[key] = std::to_string(i);
+        expected[key] = std::to_string(i);
+        break;
+      case 1: {
+        auto result = map.insert(std::make_pair(key, std::to_string(i)));
+        auto expected_result =
+            expected.insert(std::make_pair(key, std::to_string(i)));
+        ASSERT_EQ(result.second, expected_result.second);
+        ASSERT_EQ(result.first->second, expected_result.first->second);
+        break;
+      }
+      case 2:
+        ASSERT_EQ(map.erase(key), expected.erase(key));
+        break;
+      default: {
+        auto iter = map.find(key);
+        ASSERT_EQ(iter != map.end(), expected.count(key) == 1);
+        ASSERT_EQ(map.rank(key), size_type(std::distance(
+                                     expected.begin(),
+                                     expected.lower_bound(key))));
+        break;
+      }
+    }
+    ASSERT_EQ(map.size(), expected.size());
+  }
+  EXPECT_LE(map.height(), 1.45 * std::log2(map.size() + 2));
+  EXPECT_TRUE(std::equal(map.begin(), map.end(), expected.begin()));
+  size_type k = 0;
+  for (const auto& kv : expected) {
+    ASSERT_EQ(map.select(k++)->first, kv.first);
+  }
+  EXPECT_TRUE(map.select(k) == map.end());
+  EXPECT_EQ((--map.end())->first, expected.rbegin()->first);
+  EXPECT_EQ(map.at(expected.begin()->first), expected.begin()->second);
+  EXPECT_THROW(map.at(-1), std::out_of_range);
+
+  // erase every other element through iterators
+  for (auto iter = map.begin(); iter != map.end();) {
+    iter = map.erase(iter);
+    if (iter != map.end()) ++iter;
+  }
+  EXPECT_EQ(map.size(), expected.size() / 2);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+}
+
+TEST(AVLMapTest, AssignSorted) {
+  std::vector<std::pair<int, int>> values;
+  for (int i = 0; i < 1000; ++i) values.push_back(std::make_pair(2 * i, i));
+  tree::AVLMap<int, int> map;
+  map.assign_sorted(values.begin(), values.end());
+  EXPECT_EQ(map.size(), values.size());
+  EXPECT_EQ(map.height(), 9);
+  EXPECT_TRUE(std::equal(map.begin(), map.end(), values.begin(),
+                         [](const std::pair<const int, int>& lhs,
+                            const std::pair<int, int>& rhs) {
+                           return lhs.first == rhs.first &&
+                                  lhs.second == rhs.second;
+                         }));
+  EXPECT_EQ(map.rank(501), 251u);
+  EXPECT_EQ(map.select(250)->second, 250);
+  EXPECT_EQ(map.lower_bound(501)->first, 502);
+  map[1] = -1;
+  EXPECT_EQ(map.erase(0), 1u);
+  EXPECT_EQ(map.begin()->second, -1);
+
+  std::swap(values[3], values[4]);
+  EXPECT_THROW(map.assign_sorted(values.begin(), values.end()),
+               std::invalid_argument);
+  EXPECT_TRUE(map.empty());
+}
+
+template <typename T>
+class StaticSearchTest : public testing::Test {};
+
+typedef testing::Types<std::int32_t, std::uint64_t, double> SearchKeyTypes;
+TYPED_TEST_SUITE(StaticSearchTest, SearchKeyTypes);
+
+TYPED_TEST(StaticSearchTest, MatchesLowerBound) {
+  std::srand(31);
+  for (size_type n : {0, 1, 2, 15, 16, 17, 100, 289, 1000, 12345}) {
+    std::vector<TypeParam> keys(n);
+    for (auto& key : keys) key = static_cast<TypeParam>(std::rand() % (3 * n));
+    std::sort(keys.begin(), keys.end());
+    tree::EytzingerTree<TypeParam> eytzinger(keys.begin(), keys.end());
+    tree::StaticBTree<TypeParam> btree(keys.begin(), keys.end());
+    ASSERT_EQ(eytzinger.size(), n);
+    ASSERT_EQ(btree.size(), n);
+    for (size_type key = 0; key < 3 * n + 2; ++key) {
+      TypeParam probe = static_cast<TypeParam>(key);
+      size_type expected =
+          std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin();
+      ASSERT_EQ(eytzinger.lower_bound(probe), expected) << n << " " << key;
+      ASSERT_EQ(btree.lower_bound(probe), expected) << n << " " << key;
+    }
+  }
+}
+
+TEST(StaticSearchTest, Compare) {
+  std::vector<std::string> keys = {"waf", "tree", "sort", "bm", "ac"};
+  tree::EytzingerTree<std::string, std::greater<std::string>> eytzinger(
+      keys.begin(), keys.end());
+  tree::StaticBTree<std::string, std::greater<std::string>, 2> btree(
+      keys.begin(), keys.end());
+  for (const char* key : {"x", "waf", "tea", "c", "ac", "a"}) {
+    size_type expected = std::lower_bound(keys.begin(), keys.end(), key,
+                                          std::greater<std::string>()) -
+                         keys.begin();
+    EXPECT_EQ(eytzinger.lower_bound(key), expected) << key;
+    EXPECT_EQ(btree.lower_bound(key), expected) << key;
+  }
+}
+
+// int32 keys under std::less with blocks the SSE2 rank cannot take
+TEST(StaticSearchTest, Int32BlockSizes) {
+  std::vector<std::int32_t> keys(1000);
+  std::srand(2024);
+  for (auto& key : keys) key = std::rand() % 5000 - 2500;
+  std::sort(keys.begin(), keys.end());
+  tree::StaticBTree<std::int32_t, std::less<std::int32_t>, 2> btree2(
+      keys.begin(), keys.end());
+  tree::StaticBTree<std::int32_t, std::less<std::int32_t>, 6> btree6(
+      keys.begin(), keys.end());
+  tree::StaticBTree<std::int32_t, std::less<std::int32_t>, 64> btree64(
+      keys.begin(), keys.end());
+  for (std::int32_t key = -2600; key <= 2600; key += 7) {
+    size_type expected =
+        std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    EXPECT_EQ(btree2.lower_bound(key), expected) << key;
+    EXPECT_EQ(btree6.lower_bound(key), expected) << key;
+    EXPECT_EQ(btree64.lower_bound(key), expected) << key;
+  }
+}
+
 }  // namespace
 }  // namespace tree
@@ -13,6 +13,7 @@
 #include "configure/configure.h"
 #include "logging/logging.h"
 #include "serialization/serialization.h"
+#include "sorting/sorting.h"
 #include "timing/timing.h"
 #include "waf_core.h"
 #include "waf_facility.h"
@@ -1137,16 +1138,19 @@ int run_help(int argc, char* argv[]) {
 
 // =============================================================================
 
+// orders cells by value descending, then by row and column
 template <typename T>
-bool cell_compare(const Cell<T>& lhs, const Cell<T>& rhs) {
-  if (lhs.value != rhs.value) {
-    return lhs.value > rhs.value;
-  } else if (lhs.row != rhs.row) {
-    return lhs.row < rhs.row;
-  } else {
-    return lhs.column < rhs.column;
+struct CellCompare {
+  bool operator()(const Cell<T>& lhs, const Cell<T>& rhs) const {
+    if (lhs.value != rhs.value) {
+      return lhs.value > rhs.value;
+    } else if (lhs.row != rhs.row) {
+      return lhs.row < rhs.row;
+    } else {
+      return lhs.column < rhs.column;
+    }
   }
-}
+};
 
 template <typename T>
 void sort_matrix_term_pairs_pair(
@@ -1155,22 +1159,16 @@ void sort_matrix_term_pairs_pair(
     std::vector<std::vector<Cell<T> > >& term_pairs) {
   waf::Care care = waf::care_all();
   if (term_filter) care = waf::care_in(termset);
-  term_pairs.resize(1, std::vector<Cell<T> >());
-  std::vector<Cell<T> >& arr = term_pairs[0];
+  sorting::TopK<Cell<T>, CellCompare<T> > top(result_count);
   Cell<T> cell;
   Dimension dim;
   while (next_cell(is_mat, cell, dim)) {
     if (!care(cell.row) || !care(cell.column)) {
       continue;
     }
-    arr.push_back(cell);
-    push_heap(arr.begin(), arr.end(), cell_compare<T>);
-    if (arr.size() > result_count) {
-      pop_heap(arr.begin(), arr.end(), cell_compare<T>);
-      arr.pop_back();
-    }
+    top.push(cell);
   }
-  sort_heap(arr.begin(), arr.end(), cell_compare<T>);
+  term_pairs.assign(1, top.release());
 }
 
 template <typename T>
@@ -1180,25 +1178,16 @@ void sort_matrix_term_pairs_inlink(
     std::vector<std::vector<Cell<T> > >& term_pairs) {
   waf::Care care = waf::care_all();
   if (term_filter) care = waf::care_in(termset);
-  term_pairs.clear();  // column prior
+  sorting::GroupedTopK<Cell<T>, CellCompare<T> > top(result_count);
   Cell<T> cell;
   Dimension dim;
   while (next_cell(is_mat, cell, dim)) {
     if (!care(cell.row) || !care(cell.column)) {
       continue;
     }
-    if (term_pairs.size() <= cell.column) term_pairs.resize(cell.column + 1);
-    std::vector<Cell<T> >& arr = term_pairs[cell.column];
-    arr.push_back(cell);
-    push_heap(arr.begin(), arr.end(), cell_compare<T>);
-    if (arr.size() > result_count) {
-      pop_heap(arr.begin(), arr.end(), cell_compare<T>);
-      arr.pop_back();
-    }
-  }
-  for (size_t i = 0; i < term_pairs.size(); ++i) {
-    sort_heap(term_pairs[i].begin(), term_pairs[i].end(), cell_compare<T>);
+    top.push(cell.column, cell);  // column prior
   }
+  term_pairs = top.release();
 }
 
 template <typename T>
@@ -1210,27 +1199,16 @@ void sort_matrix_term_pairs_outlink(
   if (term_filter) {
     care = waf::care_in(termset);
   }
-  term_pairs.clear();  // row prior
+  sorting::GroupedTopK<Cell<T>, CellCompare<T> > top(result_count);
   Cell<T> cell;
   Dimension dim;
   while (next_cell(is_mat, cell, dim)) {
     if (!care(cell.row) || !care(cell.column)) {
       continue;
     }
-    if (term_pairs.size() <= cell.row) {
-      term_pairs.resize(cell.row + 1);
-    }
-    std::vector<Cell<T> >& arr = term_pairs[cell.row];
-    arr.push_back(cell);
-    push_heap(arr.begin(), arr.end(), cell_compare<T>);
-    if (arr.size() > result_count) {
-      pop_heap(arr.begin(), arr.end(), cell_compare<T>);
-      arr.pop_back();
-    }
-  }
-  for (size_t i = 0; i < term_pairs.size(); ++i) {
-    sort_heap(term_pairs[i].begin(), term_pairs[i].end(), cell_compare<T>);
+    top.push(cell.row, cell);  // row prior
   }
+  term_pairs = top.release();
 }
 
 template <typename T>